@@ -1,6 +1,7 @@
 #include <bbtape/config.hpp>
 
 #include <fstream>
+#include <string>
 
 #include <bbtape/json.hpp>
 
@@ -47,6 +48,15 @@ namespace
     {
       throw std::runtime_error("verify_delay_field: field delay.on_offset must be integer number!");
     }
+
+    if (file["delay"].contains("mode"))
+    {
+      const auto & mode = file["delay"]["mode"];
+      if (!mode.is_string() || (mode != "sleep" && mode != "virtual"))
+      {
+        throw std::runtime_error("verify_delay_field: field delay.mode must be \"sleep\" or \"virtual\"!");
+      }
+    }
   }
 
   void
@@ -74,19 +84,119 @@ namespace
     {
       throw std::runtime_error("verify_phlimit_field: field physical_limit.conv must be integer number!");
     }
+    if (file["physical_limit"].contains("heads"))
+    {
+      const auto & heads = file["physical_limit"]["heads"];
+      if (!heads.is_number_unsigned() || heads.get< std::size_t >() == 0)
+      {
+        throw std::runtime_error("verify_phlimit_field: field physical_limit.heads must be positive integer number!");
+      }
+    }
+  }
+
+  void
+  verify_sort_field(const nlohmann::json & file)
+  {
+    if (!file.contains("sort"))
+    {
+      return;
+    }
+
+    if (!file["sort"].is_object())
+    {
+      throw std::runtime_error("verify_sort_field: field sort must be object!");
+    }
+
+    if (file["sort"].contains("strategy"))
+    {
+      const auto & strategy = file["sort"]["strategy"];
+      if (!strategy.is_string() || (strategy != "balanced" && strategy != "polyphase"))
+      {
+        throw std::runtime_error("verify_sort_field: field sort.strategy must be \"balanced\" or \"polyphase\"!");
+      }
+    }
+
+    if (file["sort"].contains("runs"))
+    {
+      const auto & runs = file["sort"]["runs"];
+      if (!runs.is_string() || (runs != "sort" && runs != "replacement_selection" && runs != "natural"))
+      {
+        throw std::runtime_error("verify_sort_field: field sort.runs must be \"sort\", \"replacement_selection\" or \"natural\"!");
+      }
+    }
+
+    if (file["sort"].contains("read_backward") && !file["sort"]["read_backward"].is_boolean())
+    {
+      throw std::runtime_error("verify_sort_field: field sort.read_backward must be boolean!");
+    }
+  }
+
+  void
+  verify_cost_model_field(const nlohmann::json & file)
+  {
+    if (!file.contains("cost_model"))
+    {
+      return;
+    }
+
+    if (!file["cost_model"].is_object())
+    {
+      throw std::runtime_error("verify_cost_model_field: field cost_model must be object!");
+    }
+
+    for (const char * field : {"seek_overhead", "seek_per_element", "read_per_element", "write_per_element"})
+    {
+      if (!file["cost_model"].contains(field))
+      {
+        throw std::runtime_error(std::string("verify_cost_model_field: field cost_model.") + field + " missed!");
+      }
+      if (!file["cost_model"][field].is_number() || file["cost_model"][field].get< double >() < 0)
+      {
+        throw std::runtime_error(std::string("verify_cost_model_field: field cost_model.") + field + " must be non-negative number!");
+      }
+    }
+  }
+
+  void
+  verify_threads_field(const nlohmann::json & file)
+  {
+    if (!file.contains("threads"))
+    {
+      return;
+    }
+
+    if (!file["threads"].is_object())
+    {
+      throw std::runtime_error("verify_threads_field: field threads must be object!");
+    }
+
+    if (file["threads"].contains("helpers") && !file["threads"]["helpers"].is_number_unsigned())
+    {
+      throw std::runtime_error("verify_threads_field: field threads.helpers must be non-negative integer number!");
+    }
+    if (file["threads"].contains("pin") && !file["threads"]["pin"].is_boolean())
+    {
+      throw std::runtime_error("verify_threads_field: field threads.pin must be boolean!");
+    }
   }
 }
 
 bb::config
 bb::read_config_from_file(const fs::path & path)
 {
+  // the tape itself may not fit in memory, so it is dropped while parsing
   std::ifstream in(path);
-  nlohmann::json tmp;
-  in >> tmp;
+  nlohmann::json tmp = nlohmann::json::parse(in, [](int depth, nlohmann::json::parse_event_t event, nlohmann::json & parsed)
+  {
+    return !(depth == 1 && event == nlohmann::json::parse_event_t::key && parsed == "tape");
+  });
   in.close();
 
   verify_delay_field(tmp);
   verify_phlimit_field(tmp);
+  verify_sort_field(tmp);
+  verify_cost_model_field(tmp);
+  verify_threads_field(tmp);
 
   config valid_config;
 
@@ -96,11 +206,54 @@ bb::read_config_from_file(const fs::path & path)
     tmp["delay"]["on_roll"],
     tmp["delay"]["on_offset"]
   };
+  if (tmp["delay"].value("mode", "sleep") == "virtual")
+  {
+    valid_config.m_delay.mode = delay_mode::virtual_time;
+  }
 
   valid_config.m_phlimit = {
     tmp["physical_limit"]["ram"],
-    tmp["physical_limit"]["conv"]
+    tmp["physical_limit"]["conv"],
+    tmp["physical_limit"].value("heads", std::size_t(1))
+  };
+
+  valid_config.m_sort = {
+    merge_strategy::balanced,
+    run_generation::sort
   };
+  if (tmp.contains("sort") && tmp["sort"].value("strategy", "balanced") == "polyphase")
+  {
+    valid_config.m_sort.strategy = merge_strategy::polyphase;
+  }
+  if (tmp.contains("sort") && tmp["sort"].value("runs", "sort") == "replacement_selection")
+  {
+    valid_config.m_sort.runs = run_generation::replacement_selection;
+  }
+  if (tmp.contains("sort") && tmp["sort"].value("runs", "sort") == "natural")
+  {
+    valid_config.m_sort.runs = run_generation::natural;
+  }
+  if (tmp.contains("sort"))
+  {
+    valid_config.m_sort.read_backward = tmp["sort"].value("read_backward", false);
+  }
+
+  if (tmp.contains("cost_model"))
+  {
+    valid_config.m_cost = {
+      cost_kind::distance,
+      tmp["cost_model"]["seek_overhead"],
+      tmp["cost_model"]["seek_per_element"],
+      tmp["cost_model"]["read_per_element"],
+      tmp["cost_model"]["write_per_element"]
+    };
+  }
+
+  if (tmp.contains("threads"))
+  {
+    valid_config.m_threads.helpers = tmp["threads"].value("helpers", std::size_t(1));
+    valid_config.m_threads.pin = tmp["threads"].value("pin", false);
+  }
 
   return valid_config;
 }
@@ -0,0 +1,121 @@
+#include <bbtape/executor.hpp>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+bb::executor::executor(std::size_t workers, bool pin):
+  __mutex(),
+  __task_cv(),
+  __tasks(),
+  __stop(),
+  __closed(false),
+  __workers()
+{
+  if (workers == 0)
+  {
+    throw std::runtime_error("executor: workers amount is zero!");
+  }
+
+  const std::size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+  for (std::size_t i = 0; i < workers; ++i)
+  {
+    try
+    {
+      __workers.emplace_back([this]()
+      {
+        run();
+      });
+    }
+    catch (...)
+    {
+      close();
+      throw;
+    }
+
+#if defined(__linux__)
+    if (pin)
+    {
+      cpu_set_t cpu;
+      CPU_ZERO(&cpu);
+      CPU_SET(i % cpus, &cpu);
+      pthread_setaffinity_np(__workers.back().native_handle(), sizeof(cpu_set_t), &cpu);
+    }
+#else
+    (void) pin;
+    (void) cpus;
+#endif
+  }
+}
+
+bb::executor::~executor()
+{
+  close();
+}
+
+std::size_t
+bb::executor::size() const
+{
+  return __workers.size();
+}
+
+void
+bb::executor::close()
+{
+  // queued tasks are cancelled, running ones are waited for
+  __stop.request_stop();
+  {
+    std::lock_guard< std::mutex > lock(__mutex);
+    __closed = true;
+  }
+  __task_cv.notify_all();
+
+  for (auto & worker : __workers)
+  {
+    if (worker.joinable())
+    {
+      worker.join();
+    }
+  }
+}
+
+void
+bb::executor::enqueue(std::function< void() > job)
+{
+  {
+    std::lock_guard< std::mutex > lock(__mutex);
+    if (__closed)
+    {
+      throw std::runtime_error("executor: executor is closed!");
+    }
+    __tasks.push_back(std::move(job));
+  }
+  __task_cv.notify_one();
+}
+
+void
+bb::executor::run()
+{
+  while (true)
+  {
+    std::function< void() > job;
+    {
+      std::unique_lock< std::mutex > lock(__mutex);
+      __task_cv.wait(lock, [this]()
+      {
+        return __closed || !__tasks.empty();
+      });
+      if (__tasks.empty())
+      {
+        return;
+      }
+      job = std::move(__tasks.front());
+      __tasks.pop_front();
+    }
+
+    job();
+  }
+}
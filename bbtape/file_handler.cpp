@@ -1,5 +1,7 @@
 #include <bbtape/file_handler.hpp>
 
+#include <stdexcept>
+
 #include <bbtape/utils.hpp>
 
 bb::file_handler::file_handler(file_handler && rhs):
@@ -47,6 +49,14 @@ bb::file_handler::push_back(const fs::path & path)
   __files.push_back(path);
 }
 
+bb::fs::path
+bb::file_handler::release(std::size_t i)
+{
+  fs::path path = std::move(__files[i]);
+  __files[i] = fs::path();
+  return path;
+}
+
 bb::fs::path &
 bb::file_handler::operator[](std::size_t i)
 {
@@ -59,6 +69,17 @@ bb::file_handler::operator[](std::size_t i) const
   return __files[i];
 }
 
+std::span< const bb::fs::path >
+bb::file_handler::view(std::size_t pos, std::size_t count) const
+{
+  if (pos + count > __files.size())
+  {
+    throw std::runtime_error("file_handler::view: out of range!");
+  }
+
+  return std::span< const fs::path >(__files).subspan(pos, count);
+}
+
 std::size_t
 bb::file_handler::size() const
 {
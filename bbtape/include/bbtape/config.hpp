@@ -8,24 +8,80 @@ namespace bb
 {
   namespace fs = std::filesystem;
 
+  enum class delay_mode
+  {
+    sleep,
+    virtual_time
+  };
+
   struct delay
   {
     std::size_t on_read;
     std::size_t on_write;
     std::size_t on_roll;
     std::size_t on_offset;
+    delay_mode mode = delay_mode::sleep;
+  };
+
+  enum class cost_kind
+  {
+    uniform,
+    distance
+  };
+
+  struct cost_model
+  {
+    cost_kind kind = cost_kind::uniform;
+    double seek_overhead = 0;
+    double seek_per_element = 0;
+    double read_per_element = 0;
+    double write_per_element = 0;
   };
 
   struct phlimit
   {
     std::size_t ram;
     std::size_t conv;
+    // heads of every device, each keeps its own position on the tape
+    std::size_t heads = 1;
+  };
+
+  enum class merge_strategy
+  {
+    balanced,
+    polyphase
+  };
+
+  enum class run_generation
+  {
+    sort,
+    replacement_selection,
+    natural
+  };
+
+  struct sort_mode
+  {
+    merge_strategy strategy = merge_strategy::balanced;
+    run_generation runs = run_generation::sort;
+    // polyphase passes read the runs of the previous pass backward
+    bool read_backward = false;
+  };
+
+  struct thread_params
+  {
+    // workers beside the one per device, for cpu bound work
+    std::size_t helpers = 1;
+    // worker i is bound to cpu i (linux only)
+    bool pin = false;
   };
 
   struct config
   {
     delay m_delay;
     phlimit m_phlimit;
+    sort_mode m_sort = {};
+    cost_model m_cost = {};
+    thread_params m_threads = {};
   };
 
   config
@@ -0,0 +1,94 @@
+#ifndef BBTAPE_EXECUTOR_HPP
+#define BBTAPE_EXECUTOR_HPP
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bb
+{
+  /*
+    persistent workers of a sort session, tasks run in submission order,
+    a task whose token (or the executor itself) is stopped before it starts
+    is skipped and its future throws, tasks that wait for each other must
+    not outnumber the workers
+  */
+  class executor
+  {
+    public:
+      executor() = delete;
+      // with pin, worker i is bound to cpu i modulo the cpu amount (linux only)
+      explicit executor(std::size_t workers, bool pin = false);
+      executor(const executor &) = delete;
+      executor & operator=(const executor &) = delete;
+      ~executor();
+
+      template< typename F >
+      std::future< std::invoke_result_t< F & > > submit(F && task, std::stop_token token = {});
+
+      std::size_t size() const;
+
+    private:
+      std::mutex __mutex;
+      std::condition_variable __task_cv;
+      std::deque< std::function< void() > > __tasks;
+      std::stop_source __stop;
+      bool __closed;
+      std::vector< std::thread > __workers;
+
+      void close();
+      void enqueue(std::function< void() > job);
+      void run();
+  };
+}
+
+template< typename F >
+std::future< std::invoke_result_t< F & > >
+bb::executor::submit(F && task, std::stop_token token)
+{
+  using result = std::invoke_result_t< F & >;
+
+  // std::function needs a copyable job, the task itself may be move only
+  auto promise = std::make_shared< std::promise< result > >();
+  auto body = std::make_shared< std::decay_t< F > >(std::forward< F >(task));
+  auto future = promise->get_future();
+  enqueue([promise, body, token, stop = __stop.get_token()]()
+  {
+    if (token.stop_requested() || stop.stop_requested())
+    {
+      promise->set_exception(std::make_exception_ptr(std::runtime_error("executor: task is cancelled!")));
+      return;
+    }
+
+    try
+    {
+      if constexpr (std::is_void_v< result >)
+      {
+        (*body)();
+        promise->set_value();
+      }
+      else
+      {
+        promise->set_value((*body)());
+      }
+    }
+    catch (...)
+    {
+      promise->set_exception(std::current_exception());
+    }
+  });
+
+  return future;
+}
+
+#endif
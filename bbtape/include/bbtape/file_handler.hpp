@@ -3,6 +3,7 @@
 
 #include <filesystem>
 #include <vector>
+#include <span>
 
 namespace bb
 {
@@ -19,10 +20,12 @@ namespace bb
       ~file_handler();
 
       void push_back(const fs::path & path);
+      fs::path release(std::size_t i);
 
       fs::path & operator[](std::size_t i);
       const fs::path & operator[](std::size_t i) const;
 
+      std::span< const fs::path > view(std::size_t pos, std::size_t count) const;
       std::size_t size() const;
 
     private:
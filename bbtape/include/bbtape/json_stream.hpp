@@ -0,0 +1,395 @@
+#ifndef BBTAPE_JSON_STREAM_HPP
+#define BBTAPE_JSON_STREAM_HPP
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <bbtape/unit.hpp>
+#include <bbtape/utils.hpp>
+#include <bbtape/json.hpp>
+
+namespace bb
+{
+  namespace fs = std::filesystem;
+
+  /*
+    pull scanner over the top-level "tape" array of a json file,
+    hands out one element as raw json text per call, the rest of
+    the document is skipped without building a DOM
+  */
+  class json_tape_scanner
+  {
+    public:
+      json_tape_scanner() = delete;
+      explicit json_tape_scanner(const fs::path & path);
+
+      bool next(std::string & element);
+      bool done() const;
+
+    private:
+      std::filebuf __buf;
+      bool __first;
+      bool __done;
+
+      int peek();
+      int get();
+      void expect(char c);
+      void skip_ws();
+      void copy_string(std::string * dst);
+      void copy_value(std::string * dst);
+  };
+
+  template< unit_type T >
+  class json_tape_reader
+  {
+    public:
+      json_tape_reader() = delete;
+      explicit json_tape_reader(const fs::path & path);
+
+      std::size_t read(std::span< T > dst);
+      bool done() const;
+
+    private:
+      json_tape_scanner __scanner;
+      std::string __element;
+
+      T parse_element() const;
+  };
+
+  // length of the json text of a value in a tape, without its separator
+  template< unit_type T >
+  std::size_t
+  json_text_size(const T & value);
+
+  // bytes of a json tape left for values written by a json_tape_part
+  struct json_tape_room
+  {
+    fs::path path;
+    std::uint64_t offset;
+    std::uint64_t bytes;
+    // the room starts the tape, its first value has no comma
+    bool first;
+  };
+
+  template< unit_type T >
+  class json_tape_writer
+  {
+    public:
+      json_tape_writer() = delete;
+      explicit json_tape_writer(const fs::path & path);
+      json_tape_writer(const json_tape_writer &) = delete;
+      json_tape_writer & operator=(const json_tape_writer &) = delete;
+      ~json_tape_writer();
+
+      void write(std::span< const T > rhs);
+      void write(const T & rhs);
+      /*
+        skips the room of the next count values, bytes is the json_text_size
+        of all of them, so the room is filled in place by a json_tape_part
+      */
+      json_tape_room reserve(std::size_t count, std::uint64_t bytes);
+      void close();
+
+      std::size_t size() const;
+
+    private:
+      fs::path __path;
+      std::ofstream __out;
+      std::size_t __count;
+  };
+
+  /*
+    writer of a room of a json tape, the rooms of one tape are written
+    at once from different threads, each through its own file
+  */
+  template< unit_type T >
+  class json_tape_part
+  {
+    public:
+      json_tape_part() = delete;
+      explicit json_tape_part(const json_tape_room & room);
+      json_tape_part(const json_tape_part &) = delete;
+      json_tape_part & operator=(const json_tape_part &) = delete;
+      ~json_tape_part();
+
+      void write(std::span< const T > rhs);
+      void write(const T & rhs);
+      // throws if the room is not filled exactly
+      void close();
+
+    private:
+      std::ofstream __out;
+      std::uint64_t __left;
+      bool __first;
+  };
+}
+
+namespace
+{
+  template< bb::unit_type T >
+  void
+  write_json_value(std::ofstream & out, const T & value)
+  {
+    if constexpr (std::is_integral_v< T > && !std::is_same_v< T, bool >)
+    {
+      std::array< char, 64 > buf;
+      auto [ptr, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+      out.write(buf.data(), ptr - buf.data());
+    }
+    else
+    {
+      out << nlohmann::json(value).dump();
+    }
+  }
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::json_text_size(const T & value)
+{
+  if constexpr (std::is_integral_v< T > && !std::is_same_v< T, bool >)
+  {
+    std::array< char, 64 > buf;
+    auto [ptr, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+    return ptr - buf.data();
+  }
+  else
+  {
+    return nlohmann::json(value).dump().size();
+  }
+}
+
+template< bb::unit_type T >
+bb::json_tape_reader< T >::json_tape_reader(const fs::path & path):
+  __scanner(path),
+  __element()
+{}
+
+template< bb::unit_type T >
+std::size_t
+bb::json_tape_reader< T >::read(std::span< T > dst)
+{
+  std::size_t was_read = 0;
+  while (was_read < dst.size() && __scanner.next(__element))
+  {
+    dst[was_read++] = parse_element();
+  }
+
+  return was_read;
+}
+
+template< bb::unit_type T >
+bool
+bb::json_tape_reader< T >::done() const
+{
+  return __scanner.done();
+}
+
+template< bb::unit_type T >
+T
+bb::json_tape_reader< T >::parse_element() const
+{
+  if constexpr (std::is_arithmetic_v< T > && !std::is_same_v< T, bool >)
+  {
+    T value{};
+    const char * first = __element.data();
+    const char * last = first + __element.size();
+    auto [ptr, ec] = std::from_chars(first, last, value);
+    if (ec == std::errc{} && ptr == last)
+    {
+      return value;
+    }
+  }
+
+  return nlohmann::json::parse(__element).get< T >();
+}
+
+template< bb::unit_type T >
+bb::json_tape_writer< T >::json_tape_writer(const fs::path & path):
+  __path(path),
+  __out(),
+  __count(0)
+{
+  utils::verify_file_path(path);
+
+  __out.open(path, std::ios::trunc);
+  if (!__out.is_open())
+  {
+    throw std::runtime_error("json_tape_writer: can't open file!");
+  }
+
+  __out << "{\n  \"tape\": [";
+}
+
+template< bb::unit_type T >
+bb::json_tape_writer< T >::~json_tape_writer()
+{
+  try
+  {
+    close();
+  }
+  catch (...)
+  {}
+}
+
+template< bb::unit_type T >
+void
+bb::json_tape_writer< T >::write(std::span< const T > rhs)
+{
+  if (!__out.is_open())
+  {
+    throw std::runtime_error("json_tape_writer: file is closed!");
+  }
+
+  for (const auto & value : rhs)
+  {
+    __out << (__count == 0 ? "\n    " : ",\n    ");
+    write_json_value< T >(__out, value);
+    ++__count;
+  }
+
+  if (!__out)
+  {
+    throw std::runtime_error("json_tape_writer: write failed!");
+  }
+}
+
+template< bb::unit_type T >
+void
+bb::json_tape_writer< T >::write(const T & rhs)
+{
+  write(std::span< const T >{&rhs, 1});
+}
+
+template< bb::unit_type T >
+bb::json_tape_room
+bb::json_tape_writer< T >::reserve(std::size_t count, std::uint64_t bytes)
+{
+  if (!__out.is_open())
+  {
+    throw std::runtime_error("json_tape_writer: file is closed!");
+  }
+
+  // every value but the first of the tape is led by ",\n    "
+  json_tape_room room = {__path, static_cast< std::uint64_t >(__out.tellp()), bytes + count * 6, __count == 0};
+  if (room.first && count != 0)
+  {
+    room.bytes = room.bytes - 1;
+  }
+  __out.flush();
+  __out.seekp(static_cast< std::streamoff >(room.offset + room.bytes));
+  __count = __count + count;
+  if (!__out)
+  {
+    throw std::runtime_error("json_tape_writer: reserve failed!");
+  }
+
+  return room;
+}
+
+template< bb::unit_type T >
+void
+bb::json_tape_writer< T >::close()
+{
+  if (!__out.is_open())
+  {
+    return;
+  }
+
+  __out << (__count == 0 ? "]\n}" : "\n  ]\n}");
+  __out.close();
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::json_tape_writer< T >::size() const
+{
+  return __count;
+}
+
+template< bb::unit_type T >
+bb::json_tape_part< T >::json_tape_part(const json_tape_room & room):
+  __out(),
+  __left(room.bytes),
+  __first(room.first)
+{
+  // the tape is opened for update, the rest of it is kept
+  __out.open(room.path, std::ios::in | std::ios::out);
+  if (!__out.is_open())
+  {
+    throw std::runtime_error("json_tape_part: can't open file!");
+  }
+  __out.seekp(static_cast< std::streamoff >(room.offset));
+}
+
+template< bb::unit_type T >
+bb::json_tape_part< T >::~json_tape_part()
+{
+  // an unfilled room is left as it is, close() reports it
+  __out.close();
+}
+
+template< bb::unit_type T >
+void
+bb::json_tape_part< T >::write(std::span< const T > rhs)
+{
+  if (!__out.is_open())
+  {
+    throw std::runtime_error("json_tape_part: file is closed!");
+  }
+
+  for (const auto & value : rhs)
+  {
+    const std::size_t size = json_text_size(value) + (__first ? 5 : 6);
+    if (size > __left)
+    {
+      throw std::runtime_error("json_tape_part: room is too small!");
+    }
+    __out << (__first ? "\n    " : ",\n    ");
+    write_json_value< T >(__out, value);
+    __left = __left - size;
+    __first = false;
+  }
+
+  if (!__out)
+  {
+    throw std::runtime_error("json_tape_part: write failed!");
+  }
+}
+
+template< bb::unit_type T >
+void
+bb::json_tape_part< T >::write(const T & rhs)
+{
+  write(std::span< const T >{&rhs, 1});
+}
+
+template< bb::unit_type T >
+void
+bb::json_tape_part< T >::close()
+{
+  if (!__out.is_open())
+  {
+    return;
+  }
+
+  __out.close();
+  if (!__out)
+  {
+    throw std::runtime_error("json_tape_part: write failed!");
+  }
+  if (__left != 0)
+  {
+    throw std::runtime_error("json_tape_part: room is not filled!");
+  }
+}
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef BBTAPE_LOSER_TREE_HPP
+#define BBTAPE_LOSER_TREE_HPP
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <functional>
+
+#include <bbtape/unit.hpp>
+
+namespace bb
+{
+  /*
+    tournament tree over k sources, each internal node keeps the loser
+    of its match, so replacing the winner replays only one leaf-to-root path
+    (log2(k) comparisons), exhausted sources lose to everything,
+    equal keys are won by the lower source index,
+    C orders the keys (std::greater gives a max-first tree)
+  */
+  template< unit_type T, typename C = std::less< T > >
+  class loser_tree
+  {
+    public:
+      loser_tree() = delete;
+      explicit loser_tree(std::size_t k);
+
+      void set(std::size_t i, const T & key);
+      void close(std::size_t i);
+      void build();
+
+      void replace(const T & key);
+      void pop();
+
+      bool empty() const;
+      std::size_t top() const;
+      const T & top_key() const;
+      std::size_t size() const;
+
+    private:
+      std::vector< T > __keys;
+      std::vector< char > __closed;
+      std::vector< std::size_t > __tree;
+      std::size_t __k;
+      C __cmp;
+
+      bool less(std::size_t lhs, std::size_t rhs) const;
+      std::size_t build_node(std::size_t node);
+      void replay(std::size_t leaf);
+  };
+}
+
+template< bb::unit_type T, typename C >
+bb::loser_tree< T, C >::loser_tree(std::size_t k):
+  __keys(k),
+  __closed(k, 1),
+  __tree(k == 0 ? 1 : k, 0),
+  __k(k),
+  __cmp()
+{}
+
+template< bb::unit_type T, typename C >
+void
+bb::loser_tree< T, C >::set(std::size_t i, const T & key)
+{
+  __keys[i] = key;
+  __closed[i] = 0;
+}
+
+template< bb::unit_type T, typename C >
+void
+bb::loser_tree< T, C >::close(std::size_t i)
+{
+  __closed[i] = 1;
+}
+
+template< bb::unit_type T, typename C >
+void
+bb::loser_tree< T, C >::build()
+{
+  if (__k == 0)
+  {
+    return;
+  }
+
+  __tree[0] = build_node(1);
+}
+
+template< bb::unit_type T, typename C >
+void
+bb::loser_tree< T, C >::replace(const T & key)
+{
+  std::size_t winner = __tree[0];
+  __keys[winner] = key;
+  replay(winner);
+}
+
+template< bb::unit_type T, typename C >
+void
+bb::loser_tree< T, C >::pop()
+{
+  std::size_t winner = __tree[0];
+  __closed[winner] = 1;
+  replay(winner);
+}
+
+template< bb::unit_type T, typename C >
+bool
+bb::loser_tree< T, C >::empty() const
+{
+  return __k == 0 || __closed[__tree[0]];
+}
+
+template< bb::unit_type T, typename C >
+std::size_t
+bb::loser_tree< T, C >::top() const
+{
+  if (empty())
+  {
+    throw std::runtime_error("loser_tree: tree is empty!");
+  }
+
+  return __tree[0];
+}
+
+template< bb::unit_type T, typename C >
+const T &
+bb::loser_tree< T, C >::top_key() const
+{
+  return __keys[top()];
+}
+
+template< bb::unit_type T, typename C >
+std::size_t
+bb::loser_tree< T, C >::size() const
+{
+  return __k;
+}
+
+template< bb::unit_type T, typename C >
+bool
+bb::loser_tree< T, C >::less(std::size_t lhs, std::size_t rhs) const
+{
+  if (__closed[lhs] || __closed[rhs])
+  {
+    return !__closed[lhs] || (__closed[rhs] && lhs < rhs);
+  }
+  if (__cmp(__keys[lhs], __keys[rhs]))
+  {
+    return true;
+  }
+  if (__cmp(__keys[rhs], __keys[lhs]))
+  {
+    return false;
+  }
+
+  return lhs < rhs;
+}
+
+template< bb::unit_type T, typename C >
+std::size_t
+bb::loser_tree< T, C >::build_node(std::size_t node)
+{
+  if (node >= __k)
+  {
+    return node - __k;
+  }
+
+  std::size_t lhs = build_node(2 * node);
+  std::size_t rhs = build_node(2 * node + 1);
+  if (less(lhs, rhs))
+  {
+    __tree[node] = rhs;
+    return lhs;
+  }
+
+  __tree[node] = lhs;
+  return rhs;
+}
+
+template< bb::unit_type T, typename C >
+void
+bb::loser_tree< T, C >::replay(std::size_t leaf)
+{
+  std::size_t winner = leaf;
+  for (std::size_t node = (leaf + __k) / 2; node > 0; node = node / 2)
+  {
+    if (less(__tree[node], winner))
+    {
+      std::swap(__tree[node], winner);
+    }
+  }
+
+  __tree[0] = winner;
+}
+
+#endif
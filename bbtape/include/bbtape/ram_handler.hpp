@@ -7,6 +7,11 @@
 #include <span>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
 
 #include <bbtape/unit.hpp>
 
@@ -18,6 +23,13 @@ namespace bb
   template< unit_type T >
   using ram_view = std::span< T >;
 
+  /*
+    buddy allocator over the ram, block_size is the smallest block, a block
+    of order k is block_size << k elements aligned to its size, every order
+    keeps a lock-free free list (a tagged index stack), so taking a block of a
+    listed order and freeing one are O(1), a bigger block is split on the way,
+    free buddies are coalesced only when a take finds nothing big enough
+  */
   template< unit_type T >
   class ram_handler
   {
@@ -25,62 +37,182 @@ namespace bb
       ram_handler() = delete;
       ram_handler(unique_ram< T > ram, std::size_t block_size);
 
-      ram_view< T > take_ram_block();
+      // smallest block of at least size elements (one block_size by default),
+      // take throws when none is free, wait blocks until one is freed
+      ram_view< T > take_ram_block(std::size_t size = 0);
+      ram_view< T > wait_ram_block(std::size_t size = 0);
+      std::optional< ram_view< T > > try_take_ram_block(std::size_t size = 0);
       void free_ram_block(ram_view< T > block);
       unique_ram< T > pick_ram();
 
+      std::size_t block_size() const;
+      std::size_t max_block_size() const;
+
     private:
       std::mutex __mutex;
+      std::mutex __coalesce_mutex;
+      std::condition_variable __free_cv;
+      std::atomic< std::size_t > __waiters;
+
       unique_ram< T > __ram;
-      std::vector< std::atomic_flag > __blocks;
       std::size_t __block_size;
+      std::size_t __units;
+      std::size_t __max_order;
+
+      // head: tag << 32 | (unit + 1), 0 is an empty list
+      std::vector< std::atomic< std::uint64_t > > __heads;
+      std::vector< std::atomic< std::uint32_t > > __next;
+
+      std::size_t order_of(std::size_t size) const;
+      bool try_take(std::size_t order, std::size_t & unit);
+      std::optional< std::size_t > pop(std::size_t order);
+      void push(std::size_t order, std::size_t unit);
+      void coalesce();
+      ram_view< T > view(std::size_t order, std::size_t unit);
+  };
+
+  /*
+    ram that running merges may grow into: once no merge waits to start
+    (open), the blocks of finished merges are offered to the rest, a merge
+    asks again only after something new was offered
+  */
+  template< unit_type T >
+  class ram_grant
+  {
+    public:
+      ram_grant() = delete;
+      explicit ram_grant(ram_handler< T > & ram);
+
+      void open();
+      bool is_open() const;
+      void offer(ram_view< T > block);
+      std::optional< ram_view< T > > grow(std::size_t size, std::size_t & seen);
+
+    private:
+      ram_handler< T > & __ram;
+      std::atomic< bool > __open;
+      std::atomic< std::size_t > __offered;
   };
 
   std::size_t
   balance_ram_block(std::size_t ram_size, std::size_t lhs_size, std::size_t rhs_size);
+
+  std::vector< std::size_t >
+  balance_ram_blocks(std::size_t ram_size, std::span< const std::size_t > sizes);
 }
 
 template< bb::unit_type T >
 bb::ram_handler< T >::ram_handler(unique_ram< T > ram, std::size_t block_size):
   __mutex(),
+  __coalesce_mutex(),
+  __free_cv(),
+  __waiters(0),
   __ram(std::move(ram)),
-  __blocks(__ram->size() / block_size),
-  __block_size(block_size)
+  __block_size(block_size),
+  __units(0),
+  __max_order(0),
+  __heads(),
+  __next()
 {
-  for (auto & flag : __blocks)
+  if (!__ram || __block_size == 0)
+  {
+    throw std::runtime_error("ram_handler: bad ram or block size!");
+  }
+
+  __units = __ram->size() / __block_size;
+  while ((std::size_t(2) << __max_order) <= __units)
   {
-    flag.clear();
+    ++__max_order;
+  }
+  __heads = std::vector< std::atomic< std::uint64_t > >(__max_order + 1);
+  __next = std::vector< std::atomic< std::uint32_t > >(__units);
+
+  // the ram is cut into the biggest aligned blocks that fit
+  for (std::size_t unit = 0; unit < __units; )
+  {
+    std::size_t order = __max_order;
+    while ((unit % (std::size_t(1) << order)) != 0 || unit + (std::size_t(1) << order) > __units)
+    {
+      --order;
+    }
+    push(order, unit);
+    unit = unit + (std::size_t(1) << order);
   }
 }
 
 template< bb::unit_type T >
 bb::ram_view< T >
-bb::ram_handler< T >::take_ram_block()
+bb::ram_handler< T >::take_ram_block(std::size_t size)
 {
-  auto tmp = std::find_if(__blocks.begin(), __blocks.end(), [](std::atomic_flag & flag)
-  {
-    return !flag.test_and_set();
-  });
-  if (tmp == __blocks.end())
+  auto block = try_take_ram_block(size);
+  if (!block.has_value())
   {
     throw std::runtime_error("no available ram!");
   }
 
-  std::size_t offset = std::distance(__blocks.begin(), tmp);
-  auto start = __ram->data() + offset * __block_size;
-  return ram_view< T >{start, start + __block_size};
+  return *block;
+}
+
+template< bb::unit_type T >
+std::optional< bb::ram_view< T > >
+bb::ram_handler< T >::try_take_ram_block(std::size_t size)
+{
+  std::size_t order = order_of(size);
+  std::size_t unit = 0;
+  if (!try_take(order, unit))
+  {
+    return std::nullopt;
+  }
+
+  return view(order, unit);
+}
+
+template< bb::unit_type T >
+bb::ram_view< T >
+bb::ram_handler< T >::wait_ram_block(std::size_t size)
+{
+  std::size_t order = order_of(size);
+  std::size_t unit = 0;
+  if (try_take(order, unit))
+  {
+    return view(order, unit);
+  }
+
+  std::unique_lock< std::mutex > lock(__mutex);
+  __waiters.fetch_add(1);
+  __free_cv.wait(lock, [this, order, &unit]()
+  {
+    return try_take(order, unit);
+  });
+  __waiters.fetch_sub(1);
+
+  return view(order, unit);
 }
 
 template< bb::unit_type T >
 void
 bb::ram_handler< T >::free_ram_block(ram_view< T > block)
 {
-  if (block.data() - __ram->data() < 0 || block.data() > __ram->data() + __ram->size())
+  if (!__ram || block.data() < __ram->data() || block.data() + block.size() > __ram->data() + __units * __block_size)
+  {
+    throw std::runtime_error("block is not owned by ram!");
+  }
+
+  std::size_t offset = static_cast< std::size_t >(block.data() - __ram->data());
+  std::size_t order = order_of(block.size());
+  if (offset % (__block_size << order) != 0 || block.size() != (__block_size << order))
   {
     throw std::runtime_error("block is not owned by ram!");
   }
 
-  __blocks[(block.data() - __ram->data()) / __block_size].clear();
+  push(order, offset / __block_size);
+  if (__waiters.load() != 0)
+  {
+    {
+      std::lock_guard< std::mutex > lock(__mutex);
+    }
+    __free_cv.notify_all();
+  }
 }
 
 template< bb::unit_type T >
@@ -88,9 +220,207 @@ bb::unique_ram< T >
 bb::ram_handler< T >::pick_ram()
 {
   std::lock_guard< std::mutex > lock(__mutex);
-  __blocks.clear();
-  __block_size = 0;
+  for (auto & head : __heads)
+  {
+    head.store(0);
+  }
+  __units = 0;
   return std::move(__ram);
 }
 
+template< bb::unit_type T >
+std::size_t
+bb::ram_handler< T >::block_size() const
+{
+  return __block_size;
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::ram_handler< T >::max_block_size() const
+{
+  return __units == 0 ? 0 : __block_size << __max_order;
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::ram_handler< T >::order_of(std::size_t size) const
+{
+  std::size_t order = 0;
+  while ((__block_size << order) < size)
+  {
+    ++order;
+    if (order > __max_order)
+    {
+      throw std::runtime_error("ram_handler: block is bigger than ram!");
+    }
+  }
+
+  return order;
+}
+
+template< bb::unit_type T >
+bool
+bb::ram_handler< T >::try_take(std::size_t order, std::size_t & unit)
+{
+  for (int attempt = 0; attempt < 2; ++attempt)
+  {
+    for (std::size_t from = order; from < __heads.size(); ++from)
+    {
+      auto taken = pop(from);
+      if (!taken.has_value())
+      {
+        continue;
+      }
+
+      // the upper halves of a bigger block go back to the smaller lists
+      for (std::size_t split = from; split > order; --split)
+      {
+        push(split - 1, *taken + (std::size_t(1) << (split - 1)));
+      }
+      unit = *taken;
+      return true;
+    }
+
+    if (attempt == 0)
+    {
+      coalesce();
+    }
+  }
+
+  return false;
+}
+
+template< bb::unit_type T >
+std::optional< std::size_t >
+bb::ram_handler< T >::pop(std::size_t order)
+{
+  std::uint64_t head = __heads[order].load();
+  while ((head & 0xffffffff) != 0)
+  {
+    std::uint32_t unit = static_cast< std::uint32_t >(head & 0xffffffff) - 1;
+    std::uint64_t next = ((head >> 32) + 1) << 32 | __next[unit].load();
+    if (__heads[order].compare_exchange_weak(head, next))
+    {
+      return unit;
+    }
+  }
+
+  return std::nullopt;
+}
+
+template< bb::unit_type T >
+void
+bb::ram_handler< T >::push(std::size_t order, std::size_t unit)
+{
+  std::uint64_t head = __heads[order].load();
+  std::uint64_t next;
+  do
+  {
+    __next[unit].store(static_cast< std::uint32_t >(head & 0xffffffff));
+    next = ((head >> 32) + 1) << 32 | (unit + 1);
+  }
+  while (!__heads[order].compare_exchange_weak(head, next));
+}
+
+template< bb::unit_type T >
+void
+bb::ram_handler< T >::coalesce()
+{
+  // slow path: the lists are drained, free buddies are joined bottom up,
+  // blocks freed meanwhile just land in the emptied lists
+  std::lock_guard< std::mutex > lock(__coalesce_mutex);
+  std::vector< std::vector< std::size_t > > free_units(__heads.size());
+  for (std::size_t order = 0; order < __heads.size(); ++order)
+  {
+    std::uint64_t head = __heads[order].load();
+    while (!__heads[order].compare_exchange_weak(head, ((head >> 32) + 1) << 32))
+    {}
+    for (std::uint64_t unit = head & 0xffffffff; unit != 0; unit = __next[unit - 1].load())
+    {
+      free_units[order].push_back(unit - 1);
+    }
+  }
+
+  for (std::size_t order = 0; order < __heads.size(); ++order)
+  {
+    auto & units = free_units[order];
+    std::sort(units.begin(), units.end());
+    const std::size_t width = std::size_t(1) << order;
+    for (std::size_t i = 0; i < units.size(); ++i)
+    {
+      bool joined = order < __max_order
+        && i + 1 < units.size()
+        && units[i] % (2 * width) == 0
+        && units[i + 1] == units[i] + width
+        && units[i] + 2 * width <= __units;
+      if (joined)
+      {
+        free_units[order + 1].push_back(units[i]);
+        ++i;
+        continue;
+      }
+      push(order, units[i]);
+    }
+  }
+  __free_cv.notify_all();
+}
+
+template< bb::unit_type T >
+bb::ram_view< T >
+bb::ram_handler< T >::view(std::size_t order, std::size_t unit)
+{
+  auto start = __ram->data() + unit * __block_size;
+  return ram_view< T >{start, start + (__block_size << order)};
+}
+
+template< bb::unit_type T >
+bb::ram_grant< T >::ram_grant(ram_handler< T > & ram):
+  __ram(ram),
+  __open(false),
+  __offered(0)
+{}
+
+template< bb::unit_type T >
+void
+bb::ram_grant< T >::open()
+{
+  __open.store(true);
+  __offered.fetch_add(1);
+}
+
+template< bb::unit_type T >
+bool
+bb::ram_grant< T >::is_open() const
+{
+  return __open.load();
+}
+
+template< bb::unit_type T >
+void
+bb::ram_grant< T >::offer(ram_view< T > block)
+{
+  __ram.free_ram_block(block);
+  __offered.fetch_add(1);
+}
+
+template< bb::unit_type T >
+std::optional< bb::ram_view< T > >
+bb::ram_grant< T >::grow(std::size_t size, std::size_t & seen)
+{
+  std::size_t offered = __offered.load();
+  if (!__open.load() || offered == seen || size > __ram.max_block_size())
+  {
+    return std::nullopt;
+  }
+
+  auto block = __ram.try_take_ram_block(size);
+  if (!block.has_value())
+  {
+    seen = offered;
+  }
+
+  return block;
+}
+
 #endif
@@ -0,0 +1,483 @@
+#ifndef BBTAPE_RUN_FILE_HPP
+#define BBTAPE_RUN_FILE_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <bbtape/unit.hpp>
+
+namespace bb
+{
+  namespace fs = std::filesystem;
+
+  template< typename T >
+  concept run_type = unit_type< T > && std::is_trivially_copyable_v< T >;
+
+  inline constexpr std::string_view run_extension = ".bbrun";
+  inline constexpr std::uint16_t run_version = 1;
+
+  enum class run_type_kind : std::uint32_t
+  {
+    other = 0,
+    signed_integral = 1,
+    unsigned_integral = 2,
+    floating_point = 3
+  };
+
+  /*
+    on-disk layout (native byte order, 24 bytes):
+      magic "BBRN" | version u16 | endianness u8 | reserved u8 |
+      type_tag u32 | type_size u32 | count u64
+    followed by count raw values of T
+  */
+  struct run_header
+  {
+    std::uint16_t version;
+    std::uint8_t endianness;
+    std::uint32_t type_tag;
+    std::uint32_t type_size;
+    std::uint64_t count;
+  };
+
+  inline constexpr std::size_t run_header_size = 24;
+  // io window of a run writer, as big as the stream buffer it replaced
+  inline constexpr std::size_t run_window_bytes = 8192;
+  // a reader drops the pages it consumed once they add up to this
+  inline constexpr std::size_t run_drop_bytes = 1 << 20;
+
+  template< run_type T >
+  constexpr run_header
+  make_run_header(std::uint64_t count);
+
+  std::array< char, run_header_size >
+  encode_run_header(const run_header & header);
+
+  run_header
+  decode_run_header(const std::array< char, run_header_size > & raw);
+
+  void
+  verify_run_path(const fs::path & path);
+
+  /*
+    file written at explicit offsets (pwrite), so writing a run never moves
+    a shared position, the descriptor is closed with it
+  */
+  class raw_file
+  {
+    public:
+      raw_file();
+      // a writable file is created or truncated
+      raw_file(const fs::path & path, bool writable);
+      raw_file(const raw_file &) = delete;
+      raw_file(raw_file && rhs) noexcept;
+      raw_file & operator=(const raw_file &) = delete;
+      raw_file & operator=(raw_file && rhs) noexcept;
+      ~raw_file();
+
+      void write_at(std::uint64_t offset, std::span< const char > src);
+
+      bool is_open() const;
+      void close();
+
+    private:
+      int __fd;
+  };
+
+  /*
+    read only mapping of a whole file, advised for sequential reading,
+    release gives back the whole pages of a byte range that is not read
+    any more (they are read from the file again if touched)
+  */
+  class mapped_file
+  {
+    public:
+      mapped_file();
+      explicit mapped_file(const fs::path & path);
+      mapped_file(const mapped_file &) = delete;
+      mapped_file(mapped_file && rhs) noexcept;
+      mapped_file & operator=(const mapped_file &) = delete;
+      mapped_file & operator=(mapped_file && rhs) noexcept;
+      ~mapped_file();
+
+      std::span< const char > bytes() const;
+      void release(std::size_t first, std::size_t last);
+
+      static std::size_t page_size();
+
+    private:
+      char * __data;
+      std::size_t __size;
+
+      void unmap();
+  };
+
+  template< run_type T >
+  class run_writer
+  {
+    public:
+      run_writer() = delete;
+      explicit run_writer(const fs::path & path);
+      run_writer(const run_writer &) = delete;
+      run_writer(run_writer &&) = default;
+      run_writer & operator=(const run_writer &) = delete;
+      run_writer & operator=(run_writer &&) = delete;
+      ~run_writer();
+
+      void write(std::span< const T > rhs);
+      void write(const T & rhs);
+      void close();
+
+      std::size_t size() const;
+
+    private:
+      raw_file __file;
+      std::size_t __count;
+      std::vector< T > __window;
+      std::size_t __buffered;
+
+      void flush();
+      void write_values(std::size_t first, std::span< const T > src);
+  };
+
+  template< run_type T >
+  class run_reader
+  {
+    public:
+      run_reader() = delete;
+      explicit run_reader(const fs::path & path);
+      // reads only the values [first, first + count) of the run
+      run_reader(const fs::path & path, std::size_t first, std::size_t count);
+
+      std::size_t read(std::span< T > dst);
+      // reads the run from its end, dst[0] is the last unread value,
+      // a reader goes either forward or backward, never both
+      std::size_t read_backward(std::span< T > dst);
+      // value i of the range, the read position is kept
+      T at(std::size_t i);
+
+      std::size_t size() const;
+      std::size_t remaining() const;
+
+    private:
+      mapped_file __map;
+      std::size_t __first;
+      std::size_t __size;
+      std::size_t __pos;
+      // page edge up to which the consumed part is given back, set by the first read
+      std::optional< std::size_t > __dropped;
+
+      std::size_t offset(std::size_t i) const;
+      void copy_values(std::size_t first, std::span< T > dst);
+      void drop_consumed(std::size_t first, std::size_t last, bool backward);
+  };
+
+  template< run_type T >
+  unit< T >
+  read_run_from_file(const fs::path & path);
+
+  template< run_type T >
+  void
+  write_run_to_file(const fs::path & path, const unit< T > & rhs);
+}
+
+template< bb::run_type T >
+constexpr bb::run_header
+bb::make_run_header(std::uint64_t count)
+{
+  run_type_kind kind = run_type_kind::other;
+  if constexpr (std::is_floating_point_v< T >)
+  {
+    kind = run_type_kind::floating_point;
+  }
+  else if constexpr (std::is_integral_v< T > && std::is_signed_v< T >)
+  {
+    kind = run_type_kind::signed_integral;
+  }
+  else if constexpr (std::is_integral_v< T >)
+  {
+    kind = run_type_kind::unsigned_integral;
+  }
+
+  return {
+    run_version,
+    static_cast< std::uint8_t >(std::endian::native == std::endian::little ? 1 : 2),
+    static_cast< std::uint32_t >(kind),
+    static_cast< std::uint32_t >(sizeof(T)),
+    count
+  };
+}
+
+template< bb::run_type T >
+bb::run_writer< T >::run_writer(const fs::path & path):
+  __file(path, true),
+  __count(0),
+  __window(std::max< std::size_t >(1, run_window_bytes / sizeof(T))),
+  __buffered(0)
+{
+  auto header = encode_run_header(make_run_header< T >(0));
+  __file.write_at(0, header);
+}
+
+template< bb::run_type T >
+bb::run_writer< T >::~run_writer()
+{
+  try
+  {
+    close();
+  }
+  catch (...)
+  {}
+}
+
+template< bb::run_type T >
+void
+bb::run_writer< T >::write(std::span< const T > rhs)
+{
+  if (!__file.is_open())
+  {
+    throw std::runtime_error("run_writer: file is closed!");
+  }
+
+  if (__buffered + rhs.size() > __window.size())
+  {
+    flush();
+  }
+  // a block as big as the window goes to the file as it is
+  if (rhs.size() >= __window.size())
+  {
+    write_values(__count, rhs);
+  }
+  else
+  {
+    std::copy(rhs.begin(), rhs.end(), __window.begin() + __buffered);
+    __buffered = __buffered + rhs.size();
+  }
+  __count = __count + rhs.size();
+}
+
+template< bb::run_type T >
+void
+bb::run_writer< T >::write(const T & rhs)
+{
+  write(std::span< const T >{&rhs, 1});
+}
+
+template< bb::run_type T >
+void
+bb::run_writer< T >::close()
+{
+  if (!__file.is_open())
+  {
+    return;
+  }
+
+  flush();
+  auto header = encode_run_header(make_run_header< T >(__count));
+  __file.write_at(0, header);
+  __file.close();
+}
+
+template< bb::run_type T >
+std::size_t
+bb::run_writer< T >::size() const
+{
+  return __count;
+}
+
+template< bb::run_type T >
+void
+bb::run_writer< T >::flush()
+{
+  if (__buffered != 0)
+  {
+    write_values(__count - __buffered, std::span< const T >(__window).first(__buffered));
+    __buffered = 0;
+  }
+}
+
+template< bb::run_type T >
+void
+bb::run_writer< T >::write_values(std::size_t first, std::span< const T > src)
+{
+  std::span< const char > raw(reinterpret_cast< const char * >(src.data()), src.size() * sizeof(T));
+  __file.write_at(run_header_size + first * sizeof(T), raw);
+}
+
+template< bb::run_type T >
+bb::run_reader< T >::run_reader(const fs::path & path):
+  __map(),
+  __first(0),
+  __size(0),
+  __pos(0),
+  __dropped()
+{
+  verify_run_path(path);
+
+  __map = mapped_file(path);
+  auto bytes = __map.bytes();
+  if (bytes.size() < run_header_size)
+  {
+    throw std::runtime_error("run_reader: file is too short!");
+  }
+
+  std::array< char, run_header_size > raw{};
+  std::copy_n(bytes.begin(), run_header_size, raw.begin());
+  run_header header = decode_run_header(raw);
+  run_header expected = make_run_header< T >(0);
+  if (header.type_tag != expected.type_tag || header.type_size != expected.type_size)
+  {
+    throw std::runtime_error("run_reader: run type mismatch!");
+  }
+  if (bytes.size() < run_header_size + header.count * sizeof(T))
+  {
+    throw std::runtime_error("run_reader: unexpected end of file!");
+  }
+
+  __size = header.count;
+}
+
+template< bb::run_type T >
+bb::run_reader< T >::run_reader(const fs::path & path, std::size_t first, std::size_t count):
+  run_reader(path)
+{
+  if (first > __size || count > __size - first)
+  {
+    throw std::runtime_error("run_reader: range is out of run!");
+  }
+
+  __first = first;
+  __size = count;
+}
+
+template< bb::run_type T >
+std::size_t
+bb::run_reader< T >::read(std::span< T > dst)
+{
+  std::size_t to_read = std::min(dst.size(), __size - __pos);
+  copy_values(__pos, dst.first(to_read));
+
+  __pos = __pos + to_read;
+  drop_consumed(offset(0), offset(__pos), false);
+  return to_read;
+}
+
+template< bb::run_type T >
+std::size_t
+bb::run_reader< T >::read_backward(std::span< T > dst)
+{
+  std::size_t to_read = std::min(dst.size(), __size - __pos);
+  copy_values(__size - __pos - to_read, dst.first(to_read));
+
+  std::reverse(dst.begin(), dst.begin() + to_read);
+  __pos = __pos + to_read;
+  drop_consumed(offset(__size - __pos), offset(__size), true);
+  return to_read;
+}
+
+template< bb::run_type T >
+T
+bb::run_reader< T >::at(std::size_t i)
+{
+  if (i >= __size)
+  {
+    throw std::runtime_error("run_reader: index is out of run!");
+  }
+
+  T value{};
+  copy_values(i, std::span< T >(std::addressof(value), 1));
+  return value;
+}
+
+template< bb::run_type T >
+std::size_t
+bb::run_reader< T >::size() const
+{
+  return __size;
+}
+
+template< bb::run_type T >
+std::size_t
+bb::run_reader< T >::remaining() const
+{
+  return __size - __pos;
+}
+
+template< bb::run_type T >
+std::size_t
+bb::run_reader< T >::offset(std::size_t i) const
+{
+  return run_header_size + (__first + i) * sizeof(T);
+}
+
+template< bb::run_type T >
+void
+bb::run_reader< T >::copy_values(std::size_t first, std::span< T > dst)
+{
+  // the data of the file is only aligned to the header, so values are copied as bytes
+  auto bytes = __map.bytes().subspan(offset(first), dst.size() * sizeof(T));
+  std::copy(bytes.begin(), bytes.end(), reinterpret_cast< char * >(dst.data()));
+}
+
+template< bb::run_type T >
+void
+bb::run_reader< T >::drop_consumed(std::size_t first, std::size_t last, bool backward)
+{
+  // the consumed bytes [first, last) are given back in batches, a reader never comes back to them,
+  // a batch only takes the part after the page edge where the previous one stopped
+  const std::size_t page = mapped_file::page_size();
+  if (backward)
+  {
+    std::size_t edge = __dropped.value_or((last + page - 1) / page * page);
+    if (edge - first >= run_drop_bytes)
+    {
+      __map.release(first, edge);
+      edge = (first + page - 1) / page * page;
+    }
+    __dropped = edge;
+  }
+  else
+  {
+    std::size_t edge = __dropped.value_or(first / page * page);
+    if (last - edge >= run_drop_bytes)
+    {
+      __map.release(edge, last);
+      edge = last / page * page;
+    }
+    __dropped = edge;
+  }
+}
+
+template< bb::run_type T >
+bb::unit< T >
+bb::read_run_from_file(const fs::path & path)
+{
+  run_reader< T > in(path);
+  unit< T > valid_run(in.size());
+  in.read(valid_run);
+
+  return valid_run;
+}
+
+template< bb::run_type T >
+void
+bb::write_run_to_file(const fs::path & path, const unit< T > & rhs)
+{
+  verify_run_path(path);
+
+  run_writer< T > out(path);
+  out.write(rhs);
+  out.close();
+}
+
+#endif
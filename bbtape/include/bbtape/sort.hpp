@@ -9,34 +9,155 @@
 #include <bbtape/config.hpp>
 #include <bbtape/unit.hpp>
 #include <bbtape/tape_handler.hpp>
+#include <bbtape/tape_pool.hpp>
+#include <bbtape/executor.hpp>
+#include <bbtape/run_file.hpp>
+#include <bbtape/json_stream.hpp>
 #include <bbtape/sort_impl.hpp>
 
 namespace
 {
+  // smallest per-input buffer worth paying a device refill for
+  constexpr std::size_t min_merge_buffer = 8;
+
   struct sort_params
   {
     std::size_t file_amount;
     std::size_t thread_amount;
     std::size_t block_size;
+    std::size_t fan_in;
   };
 
+  std::size_t
+  get_fan_in(std::size_t block_size)
+  {
+    if (block_size < 3)
+    {
+      return 0;
+    }
+
+    // one share of the block is the output buffer
+    std::size_t fan_in = block_size / min_merge_buffer;
+    fan_in = (fan_in > 3) ? fan_in - 1 : 2;
+    return std::min(fan_in, block_size - 1);
+  }
+
+  double
+  get_merge_cost(std::size_t file_amount, std::size_t thread_amount, std::size_t fan_in)
+  {
+    // every pass moves all data once, a pass of g merges on t devices takes ceil(g / t) / g of it
+    double cost = 0;
+    while (file_amount > 1)
+    {
+      std::size_t group_amount = (file_amount + fan_in - 1) / fan_in;
+      std::size_t waves = (group_amount + thread_amount - 1) / thread_amount;
+      cost = cost + static_cast< double >(waves) / group_amount;
+      file_amount = group_amount;
+    }
+
+    return cost;
+  }
+
   sort_params
-  get_sort_params(std::size_t unit_size, std::size_t ram_size, std::size_t conv_amount)
+  get_sort_params(std::size_t file_amount, std::size_t ram_size, std::size_t conv_amount)
+  {
+    if (get_fan_in(ram_size) == 0)
+    {
+      throw std::runtime_error("ram size is too small!");
+    }
+
+    sort_params best = {file_amount, 1, ram_size, std::min(get_fan_in(ram_size), file_amount)};
+    double best_cost = get_merge_cost(file_amount, 1, best.fan_in);
+    std::size_t max_threads = std::min(conv_amount, (file_amount + 1) / 2);
+    for (std::size_t thread_amount = 2; thread_amount <= max_threads; ++thread_amount)
+    {
+      std::size_t block_size = ram_size / thread_amount;
+      std::size_t fan_in = std::min(get_fan_in(block_size), file_amount);
+      if (fan_in < 2)
+      {
+        break;
+      }
+
+      double cost = get_merge_cost(file_amount, thread_amount, fan_in);
+      if (cost < best_cost)
+      {
+        best = {file_amount, thread_amount, block_size, fan_in};
+        best_cost = cost;
+      }
+    }
+
+    return best;
+  }
+
+  std::vector< bb::merge_level >
+  get_merge_levels(std::size_t file_amount, std::size_t ram_size, std::size_t conv_amount)
   {
-    std::size_t file_amount = unit_size / ram_size;
-    if (unit_size % ram_size != 0)
+    // the passes the balanced merge would make, the last one is left out
+    std::vector< bb::merge_level > levels;
+    while (file_amount > get_fan_in(ram_size))
     {
-      ++file_amount;
+      sort_params pm = get_sort_params(file_amount, ram_size, conv_amount);
+      levels.push_back({pm.block_size, pm.fan_in});
+      file_amount = (file_amount + pm.fan_in - 1) / pm.fan_in;
     }
-    if (file_amount % 2 != 0)
+
+    return levels;
+  }
+
+  std::size_t
+  get_merge_parts(std::size_t file_amount, std::size_t ram_size, std::size_t conv_amount)
+  {
+    // the last merge is cut while every part still fits all the files,
+    // a single file is only copied, there is nothing to cut
+    std::size_t parts = 1;
+    while (file_amount > 1 && parts < conv_amount && get_fan_in(ram_size / (parts + 1)) >= file_amount)
+    {
+      ++parts;
+    }
+
+    return parts;
+  }
+
+  template< bb::run_type T >
+  std::pair< bb::file_handler, bb::unique_ram< T > >
+  split_runs(bb::run_generation runs, bb::json_tape_reader< T > & src, bb::tape_pool< T > & pool, bb::executor & exec, bb::unique_ram< T > ram, const std::filesystem::path & dst)
+  {
+    // natural runs follow the source order, so they are cut by one device
+    if (runs == bb::run_generation::natural)
     {
-      ++file_amount;
+      auto th = pool.acquire();
+      return bb::natural_runs< T >(src, th.get(), std::move(ram), dst);
     }
 
-    std::size_t thread_amount = std::min(conv_amount, file_amount / 2);
-    std::size_t block_size = ram_size / thread_amount;
+    return bb::split_parallel< T >(src, pool, exec, std::move(ram), runs);
+  }
 
-    return {file_amount, thread_amount, block_size};
+  void
+  print_virtual_time(std::ostream & out, const bb::shared_virtual_clock & clock)
+  {
+    if (clock)
+    {
+      out << std::format("> tape time: {}ms\n", clock->now());
+    }
+  }
+
+  template< bb::unit_type T >
+  void
+  print_sort_validation(std::ostream & out, const std::filesystem::path & dst, std::vector< T > & ram, bb::executor & exec)
+  {
+    bool result = exec.submit([&dst, &ram]()
+    {
+      bb::json_tape_reader< T > dst_src(dst);
+      return bb::utils::soft_sort_validation(dst_src, std::span< T >(ram));
+    }).get();
+    if (result)
+    {
+      out << std::format("soft_sort_validation: \033[32msuccess\033[0m\n");
+    }
+    else
+    {
+      out << std::format("soft_sort_validation: \033[31mfail\033[0m\n");
+    }
   }
 }
 
@@ -45,12 +166,12 @@ namespace bb
   namespace fs = std::filesystem;
   using optional_out = std::optional< std::reference_wrapper< std::ostream > >;
 
-  template< unit_type T >
+  template< run_type T >
   void
   external_merge_sort(config m_config, const fs::path & src, const fs::path & dst, optional_out out = std::nullopt);
 }
 
-template< bb::unit_type T >
+template< bb::run_type T >
 void
 bb::external_merge_sort(config m_config, const fs::path & src, const fs::path & dst, optional_out out)
 {
@@ -59,26 +180,37 @@ bb::external_merge_sort(config m_config, const fs::path & src, const fs::path &
     out->get() << "EXTERNAL_MERGE_SORT\n";
   }
 
-  auto src_tape = std::make_unique< unit< T > >(read_tape_from_file< T >(src));
-  const std::size_t ram_size = m_config.m_phlimit.ram / sizeof(T);
-  auto ram = std::make_unique< std::vector< T > >(ram_size);
-  sort_params pm = get_sort_params(src_tape->size(), ram_size, m_config.m_phlimit.conv);
-  if (pm.thread_amount == 0)
+  if (m_config.m_phlimit.conv == 0)
   {
     throw std::runtime_error("conv amount is zero!");
   }
 
-  if (out.has_value())
+  json_tape_reader< T > src_tape(src);
+  // the io buffers of the devices take an io_share-th of the working ram beside it
+  const std::size_t ram_size = m_config.m_phlimit.ram / sizeof(T) * io_share / (io_share + 1);
+  if (get_fan_in(ram_size) == 0)
   {
-    out->get() << std::format("> file_amount: {}\n", pm.file_amount);
-    out->get() << std::format("> thread_amount: {}\n", pm.thread_amount);
-    out->get() << std::format("> begin block_size: {}\n", pm.block_size);
+    throw std::runtime_error("ram size is too small!");
+  }
+
+  // polyphase: one tape is the output, the rest must fit the ram as merge inputs
+  const std::size_t tape_amount = std::min(m_config.m_phlimit.conv, get_fan_in(ram_size) + 1);
+  if (m_config.m_sort.strategy == merge_strategy::polyphase && tape_amount < 3)
+  {
+    throw std::runtime_error("polyphase: at least 3 tape handlers required!");
   }
+  auto ram = std::make_unique< std::vector< T > >(ram_size);
 
   std::vector< shared_tape_handler< T > > ths;
+  // in virtual mode all devices share one simulated clock instead of sleeping
+  shared_virtual_clock clock = nullptr;
+  if (m_config.m_delay.mode == delay_mode::virtual_time)
+  {
+    clock = std::make_shared< virtual_clock >();
+  }
   for (std::size_t i = 0; i < m_config.m_phlimit.conv; ++i)
   {
-    ths.push_back(std::make_shared< tape_handler< T > >(m_config));
+    ths.push_back(std::make_shared< tape_handler< T > >(m_config, clock));
   }
 
   if (out.has_value())
@@ -87,45 +219,95 @@ bb::external_merge_sort(config m_config, const fs::path & src, const fs::path &
   }
 
   utils::time_diff< std::chrono::milliseconds > split_time;
-  auto files_tape_ram = split_src_unit< T >(std::move(src_tape), ths[0], pm.file_amount, std::move(ram));
-  file_handler tmp_files = std::move(std::get< 0 >(files_tape_ram));
-  src_tape = std::move(std::get< 1 >(files_tape_ram));
-  ram = std::move(std::get< 2 >(files_tape_ram));
+  tape_pool< T > pool(ths);
+  // one worker per device and the helpers, the threads live as long as the sort
+  executor exec(m_config.m_phlimit.conv + m_config.m_threads.helpers, m_config.m_threads.pin);
+  auto files_ram = split_runs< T >(m_config.m_sort.runs, src_tape, pool, exec, std::move(ram), dst);
+  file_handler tmp_files = std::move(std::get< 0 >(files_ram));
+  ram = std::move(std::get< 1 >(files_ram));
+
+  // a source that natural_runs keeps in one run is already sorted in dst
+  if (m_config.m_sort.runs == run_generation::natural && tmp_files.size() == 0)
+  {
+    if (out.has_value())
+    {
+      out->get() << std::format("time: {}ms\n", split_time.get().count());
+      print_virtual_time(out->get(), clock);
+      out->get() << "> source is sorted, no merge\n";
+      print_sort_validation< T >(out->get(), dst, *ram, exec);
+    }
+    return;
+  }
+
+  if (m_config.m_sort.strategy == merge_strategy::polyphase)
+  {
+    if (out.has_value())
+    {
+      out->get() << std::format("time: {}ms\n", split_time.get().count());
+      print_virtual_time(out->get(), clock);
+      out->get() << std::format("> file_amount: {}\n", tmp_files.size());
+      out->get() << std::format("> tape_amount: {}\n", tape_amount);
+      out->get() << "polyphase start\n";
+    }
 
+    utils::time_diff< std::chrono::milliseconds > polyphase_time;
+    json_tape_writer< T > dst_tape(dst);
+    // the split is over, the tapes of the phases are the first devices of the pool
+    ram = polyphase< T >(std::move(tmp_files), pool, tape_amount, exec, std::move(ram), dst_tape, m_config.m_sort.read_backward);
+    dst_tape.close();
+
+    if (out.has_value())
+    {
+      out->get() << std::format("time: {}ms\n", polyphase_time.get().count());
+      print_virtual_time(out->get(), clock);
+      print_sort_validation< T >(out->get(), dst, *ram, exec);
+    }
+    return;
+  }
+
+  sort_params pm = get_sort_params(tmp_files.size(), ram_size, m_config.m_phlimit.conv);
   if (out.has_value())
   {
     out->get() << std::format("time: {}ms\n", split_time.get().count());
+    print_virtual_time(out->get(), clock);
+    out->get() << std::format("> file_amount: {}\n", pm.file_amount);
+    out->get() << std::format("> thread_amount: {}\n", pm.thread_amount);
+    out->get() << std::format("> begin block_size: {}\n", pm.block_size);
+    out->get() << std::format("> begin fan_in: {}\n", pm.fan_in);
     out->get() << "strategy start\n";
   }
 
+  // all the passes but the last one run as one dag of merges
   utils::time_diff< std::chrono::milliseconds > strategy_time;
-  std::size_t block_size = pm.block_size;
-  std::size_t thread_amount = pm.thread_amount;
-  while (tmp_files.size() > 1)
-  {
-    auto merge = strategy< T >(tmp_files, ths, std::move(ram), block_size, thread_amount);
-    tmp_files = std::move(std::get< 0 >(merge));
-    ram = std::move(std::get< 1 >(merge));
+  auto levels = get_merge_levels(tmp_files.size(), ram_size, m_config.m_phlimit.conv);
+  auto passes = merge_dag< T >(std::move(tmp_files), pool, exec, std::move(ram), levels);
+  tmp_files = std::move(std::get< 0 >(passes));
+  ram = std::move(std::get< 1 >(passes));
 
-    thread_amount = std::min(thread_amount, tmp_files.size() / 2);
-    block_size = (thread_amount == 0) ? 0 : ram_size / thread_amount;
+  // last pass is split over the devices, every part is streamed into its own room of dst
+  const std::size_t merge_parts = get_merge_parts(tmp_files.size(), ram_size, m_config.m_phlimit.conv);
+  json_tape_writer< T > dst_tape(dst);
+  if (merge_parts == 1)
+  {
+    // a second device, if any, writes the output behind the merge, a third one reads the forecast inputs
+    auto th = pool.acquire();
+    auto out_th = pool.try_acquire_for(std::chrono::milliseconds(0));
+    auto ahead_th = out_th ? pool.try_acquire_for(std::chrono::milliseconds(0)) : std::nullopt;
+    merge< T >(th.get(), tmp_files.view(0, tmp_files.size()), *ram, dst_tape, nullptr, std::addressof(exec), out_th ? out_th->get() : nullptr, ahead_th ? ahead_th->get() : nullptr);
+  }
+  else
+  {
+    merge_parallel< T >(pool, exec, tmp_files.view(0, tmp_files.size()), *ram, merge_parts, dst_tape);
   }
-  auto tape = read_tape_from_file< T >(tmp_files[0]);
-  write_tape_to_file(dst, tape);
+  dst_tape.close();
 
   if (out.has_value())
   {
+    out->get() << std::format("> merge levels: {}\n", levels.size());
+    out->get() << std::format("> last merge parts: {}\n", merge_parts);
     out->get() << std::format("time: {}ms\n", strategy_time.get().count());
-
-    bool result = utils::soft_sort_validation(tape);
-    if (result)
-    {
-      out->get() << std::format("soft_sort_validation: \033[32msuccess\033[0m\n");
-    }
-    else
-    {
-      out->get() << std::format("soft_sort_validation: \033[31mfail\033[0m\n");
-    }
+    print_virtual_time(out->get(), clock);
+    print_sort_validation< T >(out->get(), dst, *ram, exec);
   }
 }
 
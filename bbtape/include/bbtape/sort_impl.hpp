@@ -5,207 +5,1841 @@
 #include <utility>
 #include <tuple>
 #include <queue>
+#include <deque>
+#include <numeric>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
 #include <future>
+#include <exception>
+#include <span>
+#include <bit>
+#include <chrono>
 
 #include <bbtape/file_handler.hpp>
 #include <bbtape/tape_handler.hpp>
+#include <bbtape/tape_pool.hpp>
 #include <bbtape/ram_handler.hpp>
+#include <bbtape/loser_tree.hpp>
+#include <bbtape/run_file.hpp>
+#include <bbtape/json_stream.hpp>
 #include <bbtape/unit.hpp>
 #include <bbtape/utils.hpp>
+#include <bbtape/executor.hpp>
 
 namespace
 {
   using namespace bb;
   using namespace std;
 
+  constexpr size_t io_block_size = 4096;
+  // the io buffers of a ram view take at most this share of it on top of it
+  constexpr size_t io_share = 8;
+  constexpr size_t min_split_block = 16;
+
+  /*
+    one source shared by several split workers, io blocks are handed out
+    round robin, so every worker gets the same share of the source however
+    fast its thread runs (in virtual time mode threads don't sleep at all)
+  */
+  template< unit_type T, typename R >
+  class shared_reader
+  {
+    public:
+      shared_reader(R & src, size_t workers):
+        __mutex(),
+        __turn_cv(),
+        __src(src),
+        __active(workers, 1),
+        __turn(0)
+      {}
+
+      size_t read(size_t worker, span< T > dst)
+      {
+        unique_lock< mutex > lock(__mutex);
+        __turn_cv.wait(lock, [this, worker]()
+        {
+          return __turn == worker;
+        });
+        size_t was_read = __src.read(dst);
+        pass_turn();
+        return was_read;
+      }
+
+      bool done() const
+      {
+        lock_guard< mutex > lock(__mutex);
+        return __src.done();
+      }
+
+      void leave(size_t worker)
+      {
+        lock_guard< mutex > lock(__mutex);
+        __active[worker] = 0;
+        if (__turn == worker)
+        {
+          pass_turn();
+        }
+      }
+
+    private:
+      mutable mutex __mutex;
+      condition_variable __turn_cv;
+      R & __src;
+      vector< char > __active;
+      size_t __turn;
+
+      void pass_turn()
+      {
+        for (size_t i = 1; i <= __active.size(); ++i)
+        {
+          size_t next = (__turn + i) % __active.size();
+          if (__active[next])
+          {
+            __turn = next;
+            break;
+          }
+        }
+        __turn_cv.notify_all();
+      }
+  };
+
+  // reader interface of one worker seat, the seat is left on destruction
+  template< unit_type T, typename R >
+  class shared_reader_seat
+  {
+    public:
+      shared_reader_seat(shared_reader< T, R > & src, size_t worker):
+        __src(src),
+        __worker(worker)
+      {}
+
+      ~shared_reader_seat()
+      {
+        __src.leave(__worker);
+      }
+
+      size_t read(span< T > dst)
+      {
+        return __src.read(__worker, dst);
+      }
+
+      bool done() const
+      {
+        return __src.done();
+      }
+
+    private:
+      shared_reader< T, R > & __src;
+      size_t __worker;
+  };
+
+  /*
+    the block a device mounts for a transfer, it is heap memory beside the
+    ram view, so the io buffers made for a view share its io_share-th part
+  */
+  template< unit_type T >
+  struct io_buffer
+  {
+    unique_unit< T > tape;
+    size_t block;
+  };
+
+  template< unit_type T >
+  io_buffer< T >
+  make_io_buffer(size_t ram_size, size_t buffers = 1)
+  {
+    return {make_unique< unit< T > >(), clamp< size_t >(ram_size / (io_share * buffers), 1, io_block_size)};
+  }
+
   template< unit_type T >
   size_t
   read_from_tape_to_ram_without_roll(shared_tape_handler< T > th, size_t lhs, size_t rhs, ram_view< T > ram)
   {
-    std::size_t was_read = 0;
-    for (std::size_t pos = lhs; pos < rhs; ++pos, ++was_read)
+    return th->read_block(ram.subspan(lhs, rhs - lhs));
+  }
+
+  // heads are handed to the streams of a device in turn
+  template< unit_type T >
+  size_t
+  stream_head(const shared_tape_handler< T > & th, size_t stream)
+  {
+    return stream % th->heads();
+  }
+
+  template< unit_type T, typename R >
+  size_t
+  read_from_reader_to_ram(shared_tape_handler< T > th, R & src, ram_view< T > ram, io_buffer< T > & io_tape, size_t & origin, size_t head = 0)
+  {
+    // the device only ever holds one io block of the source, never the whole tape,
+    // origin is the logical position of the next block on the device tape
+    size_t was_read = 0;
+    while (was_read < ram.size())
+    {
+      io_tape.tape->resize(min(io_tape.block, ram.size() - was_read));
+      size_t got = src.read(*io_tape.tape);
+      if (got == 0)
+      {
+        break;
+      }
+      io_tape.tape->resize(got);
+
+      th->setup_tape(std::move(io_tape.tape), origin, head);
+      origin = origin + got;
+      if (was_read == 0)
+      {
+        th->roll(0);
+      }
+      was_read = was_read + read_from_tape_to_ram_without_roll< T >(th, was_read, was_read + got, ram);
+      io_tape.tape = th->release_tape();
+    }
+
+    return was_read;
+  }
+
+  template< run_type T >
+  size_t
+  read_backward_from_run_to_ram(shared_tape_handler< T > th, run_reader< T > & src, bool reversed, ram_view< T > ram, io_buffer< T > & io_tape, size_t & origin, size_t head = 0)
+  {
+    // origin is the logical position right behind the next block, blocks are
+    // mounted in tape order and read toward the start of the run,
+    // a reversed file keeps the run in backward tape order
+    size_t was_read = 0;
+    while (was_read < ram.size())
+    {
+      io_tape.tape->resize(min(io_tape.block, ram.size() - was_read));
+      size_t got = reversed ? src.read(*io_tape.tape) : src.read_backward(*io_tape.tape);
+      if (got == 0)
+      {
+        break;
+      }
+      io_tape.tape->resize(got);
+      reverse(io_tape.tape->begin(), io_tape.tape->end());
+
+      th->setup_tape(std::move(io_tape.tape), origin - got, head);
+      origin = origin - got;
+      th->roll(got);
+      was_read = was_read + th->read_block_backward(ram.subspan(was_read, got));
+      io_tape.tape = th->release_tape();
+    }
+
+    return was_read;
+  }
+
+  template< unit_type T, unit_writer< T > W >
+  void
+  write_from_ram_to_writer(shared_tape_handler< T > th, ram_view< T > ram, W & dst, io_buffer< T > & io_tape, size_t & origin, size_t head = 0)
+  {
+    for (size_t done = 0; done < ram.size(); )
+    {
+      size_t block = min(io_tape.block, ram.size() - done);
+      io_tape.tape->resize(block);
+      th->setup_tape(std::move(io_tape.tape), origin, head);
+      origin = origin + block;
+      if (done == 0)
+      {
+        th->roll(0);
+      }
+      th->write_block(ram.subspan(done, block));
+      io_tape.tape = th->release_tape();
+      dst.write(*io_tape.tape);
+      done = done + block;
+    }
+  }
+
+  // one merge input, read forward from origin or backward down from origin
+  template< run_type T >
+  struct merge_input
+  {
+    shared_tape_handler< T > th;
+    run_reader< T > run;
+    size_t origin;
+    bool backward;
+    bool reversed;
+    size_t head = 0;
+  };
+
+  // the input may be read through another device than its own, one lent for forecasting
+  template< run_type T >
+  size_t
+  refill(merge_input< T > & src, ram_view< T > ram, io_buffer< T > & io_tape, const shared_tape_handler< T > & th, size_t head)
+  {
+    if (src.backward)
+    {
+      return read_backward_from_run_to_ram< T >(th, src.run, src.reversed, ram, io_tape, src.origin, head);
+    }
+
+    return read_from_reader_to_ram< T >(th, src.run, ram, io_tape, src.origin, head);
+  }
+
+  template< run_type T >
+  size_t
+  refill(merge_input< T > & src, ram_view< T > ram, io_buffer< T > & io_tape)
+  {
+    return refill< T >(src, ram, io_tape, src.th, src.head);
+  }
+
+  /*
+    buffers a merge grew into, a buffer is only replaced while empty (on its
+    next refill or drain), a grown block is known by its memory, so buffers
+    may change hands, the grown blocks go back to the grant at the end
+  */
+  template< unit_type T >
+  class grown_buffers
+  {
+    public:
+      explicit grown_buffers(ram_grant< T > * grant):
+        __grant(grant),
+        __seen(0),
+        __blocks()
+      {}
+
+      ~grown_buffers()
+      {
+        for (auto & block : __blocks)
+        {
+          __grant->offer(block);
+        }
+      }
+
+      void grow(ram_view< T > & buffer)
+      {
+        if (!__grant)
+        {
+          return;
+        }
+
+        auto block = __grant->grow(2 * buffer.size(), __seen);
+        if (!block.has_value())
+        {
+          return;
+        }
+
+        auto old = find_if(__blocks.begin(), __blocks.end(), [&buffer](const auto & grown)
+        {
+          return grown.data() == buffer.data();
+        });
+        if (old != __blocks.end())
+        {
+          __grant->offer(*old);
+          *old = *block;
+        }
+        else
+        {
+          __blocks.push_back(*block);
+        }
+        buffer = *block;
+      }
+
+    private:
+      ram_grant< T > * __grant;
+      size_t __seen;
+      vector< ram_view< T > > __blocks;
+  };
+
+  /*
+    device io handed to the executor, whoever comes first runs it: a worker,
+    or the merge itself once it needs the result, so a merge waiting for its
+    io never waits for a free worker
+  */
+  class io_task
+  {
+    public:
+      io_task() = default;
+      io_task(io_task &&) = default;
+      io_task & operator=(io_task && rhs)
+      {
+        wait();
+        __state = std::move(rhs.__state);
+        __done = std::move(rhs.__done);
+        return *this;
+      }
+
+      template< typename F >
+      io_task(executor & exec, F && task):
+        __state(make_shared< state >()),
+        __done()
+      {
+        __state->task = std::forward< F >(task);
+        __done = __state->result.get_future();
+        exec.submit([state = __state]()
+        {
+          run(*state);
+        });
+      }
+
+      ~io_task()
+      {
+        wait();
+      }
+
+      bool valid() const
+      {
+        return __done.valid();
+      }
+
+      size_t get()
+      {
+        run(*__state);
+        return __done.get();
+      }
+
+    private:
+      struct state
+      {
+        atomic< bool > claimed = false;
+        function< size_t() > task;
+        promise< size_t > result;
+      };
+
+      shared_ptr< state > __state;
+      future< size_t > __done;
+
+      static void run(state & task)
+      {
+        if (task.claimed.exchange(true))
+        {
+          return;
+        }
+
+        try
+        {
+          task.result.set_value(task.task());
+        }
+        catch (...)
+        {
+          task.result.set_exception(current_exception());
+        }
+      }
+
+      void wait()
+      {
+        if (valid())
+        {
+          run(*__state);
+          __done.wait();
+        }
+      }
+  };
+
+  /*
+    k-way merge of streams ordered by C, the output goes through th from origin,
+    with an executor a stream that has its device to itself is double buffered:
+    one half of its buffer is merged while the other is read ahead (or written
+    behind) by its device, the streams sharing a device are read in place,
+    with a spare device (ahead_th) the next block of the one forecast to run
+    out first is read through it into a spare buffer
+  */
+  template< run_type T, typename C, unit_writer< T > W >
+  void
+  merge_inputs(vector< merge_input< T > > & src, shared_tape_handler< T > th, size_t origin, ram_view< T > ram, W & dst, ram_grant< T > * grant, executor * exec = nullptr, shared_tape_handler< T > ahead_th = nullptr)
+  {
+    const size_t fan_in = src.size();
+    vector< size_t > sizes;
+    for (const auto & in : src)
+    {
+      sizes.push_back(in.run.size());
+    }
+
+    // a device shared by several streams mounts one block at a time, so its io stays in order
+    auto own_device = [&src, &th](const shared_tape_handler< T > & device)
+    {
+      size_t users = (th == device) ? 1 : 0;
+      for (const auto & in : src)
+      {
+        users = users + (in.th == device ? 1 : 0);
+      }
+      return users == 1;
+    };
+
+    // the output takes the first head of its device, so it stays where it stopped
+    const size_t out_head = stream_head< T >(th, 0);
+    for (size_t i = 0; i < fan_in; ++i)
+    {
+      size_t stream = (src[i].th == th) ? 1 : 0;
+      for (size_t j = 0; j < i; ++j)
+      {
+        stream = stream + (src[j].th == src[i].th ? 1 : 0);
+      }
+      src[i].head = stream_head< T >(src[i].th, stream);
+    }
+
+    ram_view< T > out_ram = ram.last(ram.size() / (fan_in + 1));
+    ram_view< T > in_ram = ram.first(ram.size() - out_ram.size());
+
+    // the spare takes the share of the largest stream read in place, like a half of an async buffer it holds two values at least
+    size_t spare_share = 0;
+    for (const auto & in : src)
+    {
+      if (!own_device(in.th))
+      {
+        spare_share = max(spare_share, in.run.size());
+      }
+    }
+    const bool forecasting = exec && ahead_th && ahead_th != th && spare_share != 0
+      && in_ram.size() / (fan_in + 1) >= 2
+      && none_of(src.begin(), src.end(), [&ahead_th](const auto & in)
+      {
+        return in.th == ahead_th;
+      });
+    if (forecasting)
+    {
+      sizes.push_back(spare_share);
+    }
+    auto parts = balance_ram_blocks(in_ram.size(), sizes);
+
+    // the output is written behind while the other half fills up
+    // the io tape of an async stream is on its device while a task runs
+    vector< char > in_async(fan_in, 0);
+    for (size_t i = 0; i < fan_in; ++i)
+    {
+      in_async[i] = exec && parts[i] >= 2 && own_device(src[i].th);
+    }
+    const bool out_async = exec && out_ram.size() >= 2 && own_device(th);
+
+    // the synchronous streams share one io buffer, every async one has its own
+    const size_t buffers = 1 + count(in_async.begin(), in_async.end(), 1) + (out_async ? 1 : 0) + (forecasting ? 1 : 0);
+    auto io_tape = make_io_buffer< T >(ram.size(), buffers);
+
+    vector< ram_view< T > > in_rams(fan_in);
+    vector< ram_view< T > > in_spares(fan_in);
+    vector< size_t > in_pos(fan_in, 0);
+    vector< size_t > in_end(fan_in, 0);
+    vector< size_t > in_left(sizes.begin(), sizes.begin() + fan_in);
+    vector< io_buffer< T > > in_tapes(fan_in);
+    vector< io_task > ahead(fan_in);
+    grown_buffers< T > grown(grant);
+
+    auto read_ahead = [&](size_t i)
+    {
+      ahead[i] = io_task(*exec, [&src, &in_tapes, i, spare = in_spares[i]]()
+      {
+        return refill< T >(src[i], spare, in_tapes[i]);
+      });
+    };
+
+    loser_tree< T, C > tree(fan_in);
+    size_t offset = 0;
+    for (size_t i = 0; i < fan_in; ++i)
+    {
+      in_rams[i] = in_ram.subspan(offset, parts[i]);
+      offset = offset + parts[i];
+
+      if (in_async[i])
+      {
+        in_spares[i] = in_rams[i].last(parts[i] / 2);
+        in_rams[i] = in_rams[i].first(parts[i] - parts[i] / 2);
+        in_tapes[i] = make_io_buffer< T >(ram.size(), buffers);
+        in_end[i] = refill< T >(src[i], in_rams[i], in_tapes[i]);
+        if (in_end[i] == in_rams[i].size())
+        {
+          read_ahead(i);
+        }
+      }
+      else
+      {
+        in_end[i] = refill< T >(src[i], in_rams[i], io_tape);
+        in_left[i] = in_left[i] - in_end[i];
+      }
+      if (in_end[i] != 0)
+      {
+        tree.set(i, in_rams[i][0]);
+      }
+    }
+    tree.build();
+
+    /*
+      forecasting: the buffers are consumed in key order, so of the loaded
+      streams the one with the first last key runs out first (equal keys are
+      taken from the lower stream first), the spare is filled for it through
+      ahead_th meanwhile, the io of th goes on beside it
+    */
+    const size_t none = fan_in;
+    ram_view< T > spare = forecasting ? in_ram.subspan(offset, parts.back()) : ram_view< T >();
+    io_buffer< T > spare_tape = make_io_buffer< T >(ram.size(), buffers);
+    io_task forecast_task;
+    size_t forecast = none;
+    C cmp;
+
+    auto predict = [&]()
+    {
+      forecast = none;
+      for (size_t j = 0; j < fan_in && forecasting; ++j)
+      {
+        if (in_async[j] || in_left[j] == 0 || in_end[j] == 0)
+        {
+          continue;
+        }
+        if (forecast == none || cmp(in_rams[j][in_end[j] - 1], in_rams[forecast][in_end[forecast] - 1]))
+        {
+          forecast = j;
+        }
+      }
+      if (forecast != none)
+      {
+        forecast_task = io_task(*exec, [&src, &spare_tape, &ahead_th, f = forecast, into = spare]()
+        {
+          return refill< T >(src[f], into, spare_tape, ahead_th, stream_head< T >(ahead_th, 0));
+        });
+      }
+    };
+    predict();
+
+    ram_view< T > out_spare;
+    io_buffer< T > out_tape;
+    io_task behind;
+    if (out_async)
+    {
+      out_spare = out_ram.last(out_ram.size() / 2);
+      out_ram = out_ram.first(out_ram.size() - out_spare.size());
+      out_tape = make_io_buffer< T >(ram.size(), buffers);
+    }
+
+    size_t out_pos = 0;
+    while (!tree.empty())
+    {
+      size_t i = tree.top();
+      out_ram[out_pos++] = in_rams[i][in_pos[i]++];
+      if (out_pos == out_ram.size())
+      {
+        if (out_async)
+        {
+          if (behind.valid())
+          {
+            behind.get();
+          }
+          behind = io_task(*exec, [&th, &dst, &out_tape, &origin, out_head, full = out_ram]()
+          {
+            write_from_ram_to_writer< T >(th, full, dst, out_tape, origin, out_head);
+            return full.size();
+          });
+          swap(out_ram, out_spare);
+        }
+        else
+        {
+          write_from_ram_to_writer< T >(th, out_ram, dst, io_tape, origin, out_head);
+          grown.grow(out_ram);
+        }
+        out_pos = 0;
+      }
+
+      if (in_pos[i] == in_end[i])
+      {
+        if (in_async[i])
+        {
+          in_end[i] = ahead[i].valid() ? ahead[i].get() : 0;
+          swap(in_rams[i], in_spares[i]);
+          if (in_end[i] == in_rams[i].size())
+          {
+            read_ahead(i);
+          }
+        }
+        else if (i == forecast)
+        {
+          in_end[i] = forecast_task.get();
+          in_left[i] = in_left[i] - in_end[i];
+          swap(in_rams[i], spare);
+          grown.grow(spare);
+          predict();
+        }
+        else
+        {
+          grown.grow(in_rams[i]);
+          in_end[i] = refill< T >(src[i], in_rams[i], io_tape);
+          in_left[i] = in_left[i] - in_end[i];
+        }
+        in_pos[i] = 0;
+      }
+
+      if (in_pos[i] < in_end[i])
+      {
+        tree.replace(in_rams[i][in_pos[i]]);
+      }
+      else
+      {
+        tree.pop();
+      }
+    }
+
+    if (behind.valid())
+    {
+      behind.get();
+    }
+    write_from_ram_to_writer< T >(th, out_ram.first(out_pos), dst, out_async ? out_tape : io_tape, origin, out_head);
+  }
+
+  // finished merges of a dag, reported by the merge threads to the dispatcher
+  class merge_events
+  {
+    public:
+      struct event
+      {
+        size_t node;
+        fs::path path;
+        // tape time the merge is done at
+        size_t finish;
+        exception_ptr error;
+      };
+
+      void push(event done)
+      {
+        // notified under the lock: the last event lets the dispatcher return and destroy this
+        lock_guard< mutex > lock(__mutex);
+        __events.push_back(std::move(done));
+        __event_cv.notify_one();
+      }
+
+      // waits for at least one event and takes all of them
+      vector< event > wait()
+      {
+        unique_lock< mutex > lock(__mutex);
+        __event_cv.wait(lock, [this]()
+        {
+          return !__events.empty();
+        });
+        vector< event > done = std::move(__events);
+        __events.clear();
+        return done;
+      }
+
+      vector< event > take()
+      {
+        lock_guard< mutex > lock(__mutex);
+        vector< event > done = std::move(__events);
+        __events.clear();
+        return done;
+      }
+
+    private:
+      mutex __mutex;
+      condition_variable __event_cv;
+      vector< event > __events;
+  };
+
+  // values of run j that come before the pivot (value key, run pj, position pi) in the merge
+  template< run_type T >
+  size_t
+  count_before(run_reader< T > & run, size_t j, const T & key, size_t pj, size_t pi)
+  {
+    if (j == pj)
+    {
+      return pi;
+    }
+
+    // equal keys are taken from the lower run first
+    size_t lo = 0;
+    size_t hi = run.size();
+    while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      T value = run.at(mid);
+      bool before = (j < pj) ? !(key < value) : value < key;
+      if (before)
+      {
+        lo = mid + 1;
+      }
+      else
+      {
+        hi = mid;
+      }
+    }
+
+    return lo;
+  }
+
+  /*
+    co-ranking: positions in the runs that split their merge after rank values,
+    the pivot is the weighted median of the middles of the still open ranges,
+    so every step closes at least a quarter of the open values
+  */
+  template< run_type T >
+  vector< size_t >
+  select_rank(vector< run_reader< T > > & src, size_t rank)
+  {
+    struct candidate
+    {
+      T key;
+      size_t run;
+      size_t pos;
+      size_t weight;
+    };
+
+    const size_t k = src.size();
+    vector< size_t > lo(k, 0);
+    vector< size_t > hi(k, 0);
+    for (size_t j = 0; j < k; ++j)
+    {
+      hi[j] = src[j].size();
+    }
+
+    vector< candidate > candidates;
+    vector< size_t > counts(k, 0);
+    while (true)
+    {
+      candidates.clear();
+      size_t open = 0;
+      for (size_t j = 0; j < k; ++j)
+      {
+        if (lo[j] < hi[j])
+        {
+          size_t pos = lo[j] + (hi[j] - lo[j]) / 2;
+          candidates.push_back({src[j].at(pos), j, pos, hi[j] - lo[j]});
+          open = open + hi[j] - lo[j];
+        }
+      }
+      if (candidates.empty())
+      {
+        return lo;
+      }
+
+      sort(candidates.begin(), candidates.end(), [](const candidate & lhs, const candidate & rhs)
+      {
+        return lhs.key < rhs.key || (!(rhs.key < lhs.key) && lhs.run < rhs.run);
+      });
+      size_t median = 0;
+      for (size_t weight = 0; 2 * (weight + candidates[median].weight) < open; ++median)
+      {
+        weight = weight + candidates[median].weight;
+      }
+      const candidate & pivot = candidates[median];
+
+      size_t before = 0;
+      for (size_t j = 0; j < k; ++j)
+      {
+        counts[j] = count_before< T >(src[j], j, pivot.key, pivot.run, pivot.pos);
+        before = before + counts[j];
+      }
+
+      if (before < rank)
+      {
+        for (size_t j = 0; j < k; ++j)
+        {
+          lo[j] = max(lo[j], counts[j]);
+        }
+        lo[pivot.run] = max(lo[pivot.run], pivot.pos + 1);
+      }
+      else
+      {
+        for (size_t j = 0; j < k; ++j)
+        {
+          hi[j] = min(hi[j], counts[j]);
+        }
+      }
+    }
+  }
+
+  /*
+    json text size of the values [first, last) of a run, an integer text
+    only grows away from zero, so a range with both ends of one sign and
+    one size is counted at once and the rest is halved, other types are
+    counted value by value
+  */
+  template< run_type T >
+  uint64_t
+  run_text_size(run_reader< T > & run, size_t first, size_t last)
+  {
+    if (first == last)
+    {
+      return 0;
+    }
+
+    if constexpr (is_integral_v< T > && !is_same_v< T, bool >)
+    {
+      const T lhs = run.at(first);
+      const T rhs = run.at(last - 1);
+      const size_t size = json_text_size(lhs);
+      if ((lhs < T{}) == (rhs < T{}) && size == json_text_size(rhs))
+      {
+        return size * (last - first);
+      }
+      if (last - first > 1)
+      {
+        const size_t middle = first + (last - first) / 2;
+        return run_text_size< T >(run, first, middle) + run_text_size< T >(run, middle, last);
+      }
+    }
+
+    uint64_t size = 0;
+    for (size_t i = first; i < last; ++i)
+    {
+      size = size + json_text_size(run.at(i));
+    }
+    return size;
+  }
+}
+
+namespace bb
+{
+  template< unit_type T >
+  using shared_ths_view = shared_tape_handlers_view< T >;
+
+  /*
+    a run laid on the device tape of th at logical positions [begin, begin + size),
+    the file holds it in tape order, a run without an order is an ascending file
+    that may be laid either way, so it is read in the order the merge needs
+  */
+  template< run_type T >
+  struct tape_run
+  {
+    fs::path path;
+    shared_tape_handler< T > th;
+    std::size_t begin;
+    std::size_t size;
+    std::optional< bool > descending;
+  };
+
+  // one level of a merge plan: the ram block and the fan in of its merges
+  struct merge_level
+  {
+    std::size_t block_size;
+    std::size_t fan_in;
+  };
+
+  /*
+    all the levels of the balanced merge as one dag, the files of a level are
+    spread evenly over its groups, a merge starts as soon as its inputs exist
+    and a device and a ram block are free, lower levels first, so there is no
+    barrier between the passes, returns the files of the last level
+  */
+  template< run_type T >
+  std::pair< file_handler, unique_ram< T > >
+  merge_dag(file_handler src, tape_pool< T > & pool, executor & exec, unique_ram< T > ram, std::span< const merge_level > levels);
+
+  // the phases run on the first tape_amount devices of the pool
+  template< run_type T, unit_writer< T > W >
+  unique_ram< T >
+  polyphase(file_handler src, tape_pool< T > & pool, std::size_t tape_amount, executor & exec, unique_ram< T > ram, W & dst, bool read_backward = false);
+
+  /*
+    run generation on one device: the source is read from the front of the
+    device tape (in_origin), the runs are written over the part already
+    read (out_origin, by the second head if the device has one)
+  */
+  template< run_type T, typename R >
+  file_handler
+  split_src_unit(R & src, shared_tape_handler< T > th, ram_view< T > ram);
+
+  template< run_type T >
+  std::pair< file_handler, unique_ram< T > >
+  split_src_unit(json_tape_reader< T > & src, shared_tape_handler< T > th, unique_ram< T > ram);
+
+  template< run_type T, typename R >
+  file_handler
+  replacement_selection(R & src, shared_tape_handler< T > th, ram_view< T > ram);
+
+  template< run_type T >
+  std::pair< file_handler, unique_ram< T > >
+  replacement_selection(json_tape_reader< T > & src, shared_tape_handler< T > th, unique_ram< T > ram);
+
+  template< run_type T >
+  std::pair< file_handler, unique_ram< T > >
+  split_parallel(json_tape_reader< T > & src, tape_pool< T > & pool, executor & exec, unique_ram< T > ram, run_generation runs);
+
+  /*
+    the current run takes every value not less than its last one and goes
+    straight into the json tape dst, the rest is spilled from ram as sorted
+    runs, so no files mean dst holds the sorted source
+  */
+  template< run_type T >
+  std::pair< file_handler, unique_ram< T > >
+  natural_runs(json_tape_reader< T > & src, shared_tape_handler< T > th, unique_ram< T > ram, const fs::path & dst);
+
+  /*
+    with a grant the merge grows its buffers into ram freed by other merges,
+    with an executor and an output device of its own (out_th) the output
+    is written behind the merge on that device, with one more device
+    (ahead_th) the input forecast to run out first is read ahead on it
+  */
+  template< run_type T, unit_writer< T > W >
+  void
+  merge(shared_tape_handler< T > th, std::span< const fs::path > src, ram_view< T > ram, W & dst, ram_grant< T > * grant = nullptr, executor * exec = nullptr, shared_tape_handler< T > out_th = nullptr, shared_tape_handler< T > ahead_th = nullptr);
+
+  template< run_type T >
+  fs::path
+  merge(shared_tape_handler< T > th, std::span< const fs::path > src, ram_view< T > ram, ram_grant< T > * grant = nullptr, executor * exec = nullptr, shared_tape_handler< T > out_th = nullptr, shared_tape_handler< T > ahead_th = nullptr);
+
+  /*
+    merge of runs lying on their own devices, the output is written through th
+    from origin in descending or ascending order, a run is read backward when
+    its order differs from the output one, so a pass can read the runs of the
+    previous pass from where their writing stopped, with an executor the runs
+    are read ahead and the output is written behind on their own devices
+  */
+  template< run_type T, unit_writer< T > W >
+  void
+  merge(std::span< const tape_run< T > > src, bool descending, shared_tape_handler< T > th, std::size_t origin, ram_view< T > ram, W & dst, executor * exec = nullptr);
+
+  template< run_type T >
+  fs::path
+  merge(std::span< const tape_run< T > > src, bool descending, shared_tape_handler< T > th, std::size_t origin, ram_view< T > ram, executor * exec = nullptr);
+
+  // positions in the runs of src that split their merge after rank values
+  template< run_type T >
+  std::vector< std::size_t >
+  co_rank(std::span< const fs::path > src, std::size_t rank);
+
+  /*
+    merge path: one merge of src is cut by co_rank into parts merges of equal
+    output size, each on its own device and share of ram, every part is merged
+    straight into its own room of dst, so the output is written once
+  */
+  template< run_type T >
+  void
+  merge_parallel(tape_pool< T > & pool, executor & exec, std::span< const fs::path > src, ram_view< T > ram, std::size_t parts, json_tape_writer< T > & dst);
+}
+
+template< bb::run_type T >
+std::pair< bb::file_handler, bb::unique_ram< T > >
+bb::merge_dag(file_handler src, tape_pool< T > & pool, executor & exec, unique_ram< T > ram, std::span< const merge_level > levels)
+{
+  if (pool.size() < 1)
+  {
+    throw std::runtime_error("merge_dag: tape handlers amount is too small!");
+  }
+  if (levels.empty())
+  {
+    return std::make_pair(std::move(src), std::move(ram));
+  }
+
+  // every level gets the biggest block of whole grains the buddy allocator grants
+  // not above its own, its fan in shrinks with it, so the planned buffers stay
+  std::size_t min_block = levels[0].block_size;
+  for (const auto & level : levels)
+  {
+    if (level.fan_in < 2)
+    {
+      throw std::runtime_error("merge_dag: fan in is too small!");
+    }
+    min_block = std::min(min_block, level.block_size);
+  }
+  const std::size_t grain = min_block >> std::min(4, std::countr_zero(min_block));
+  std::vector< std::size_t > level_block;
+  std::vector< std::size_t > level_fan_in;
+  for (const auto & level : levels)
+  {
+    level_block.push_back(std::bit_floor(level.block_size / grain) * grain);
+    const std::size_t buffer = std::max< std::size_t >(1, level.block_size / (level.fan_in + 1));
+    level_fan_in.push_back(std::clamp< std::size_t >(level_block.back() / buffer, 3, level.fan_in + 1) - 1);
+  }
+
+  // the files of the nodes, leaves first, then merges in plan order
+  file_handler files = std::move(src);
+  const std::size_t leaf_amount = files.size();
+  std::vector< std::vector< std::size_t > > inputs(leaf_amount);
+  std::vector< std::size_t > node_level(leaf_amount, 0);
+  std::vector< std::size_t > current(leaf_amount);
+  std::iota(current.begin(), current.end(), std::size_t(0));
+  for (std::size_t level = 0; level < levels.size(); ++level)
+  {
+    // a group of one file goes on to the next level without a merge
+    std::vector< std::size_t > next;
+    const std::size_t group_amount = (current.size() + level_fan_in[level] - 1) / level_fan_in[level];
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < group_amount; ++i)
+    {
+      std::size_t count = current.size() / group_amount + (i < current.size() % group_amount ? 1 : 0);
+      if (count == 1)
+      {
+        next.push_back(current[pos++]);
+        continue;
+      }
+
+      next.push_back(inputs.size());
+      inputs.emplace_back(current.begin() + pos, current.begin() + pos + count);
+      node_level.push_back(level);
+      files.push_back(fs::path());
+      pos = pos + count;
+    }
+    current = std::move(next);
+  }
+
+  const std::size_t node_amount = inputs.size();
+  std::vector< std::size_t > parent(node_amount, node_amount);
+  std::vector< std::size_t > waiting(node_amount, 0);
+  for (std::size_t node = leaf_amount; node < node_amount; ++node)
+  {
+    for (auto input : inputs[node])
+    {
+      parent[input] = node;
+      waiting[node] = waiting[node] + (input >= leaf_amount ? 1 : 0);
+    }
+  }
+
+  ram_handler rhandler(std::move(ram), grain);
+  ram_grant< T > grant(rhandler);
+
+  // a merge starts at the tape time its inputs are done at, or later if it waited for ram,
+  // the merges run at host speed in virtual mode, so the order they end in tells nothing,
+  // and the block of a merge is freed here with its event, not when the host is done with it
+  const std::size_t begin = pool.elapsed();
+  std::vector< std::size_t > done_at(node_amount, begin);
+  std::vector< ram_view< T > > node_block(node_amount);
+  std::size_t ram_at = begin;
+  bool starved = false;
+
+  using ready_node = std::pair< std::size_t, std::size_t >;
+  std::priority_queue< ready_node, std::vector< ready_node >, std::greater< ready_node > > ready;
+  for (std::size_t node = leaf_amount; node < node_amount; ++node)
+  {
+    if (waiting[node] == 0)
+    {
+      ready.push({node_level[node], node});
+    }
+  }
+
+  merge_events events;
+  std::vector< std::future< void > > merges;
+  std::stop_source stop;
+  std::size_t launched = 0;
+  std::size_t in_flight = 0;
+  std::exception_ptr error = nullptr;
+  try
+  {
+    while (true)
+    {
+      while (!error && !ready.empty() && in_flight < pool.size())
+      {
+        auto [level, node] = ready.top();
+        auto block = rhandler.try_take_ram_block(level_block[level]);
+        if (!block.has_value())
+        {
+          starved = true;
+          break;
+        }
+        ready.pop();
+        node_block[node] = *block;
+
+        std::vector< fs::path > group;
+        std::size_t at = ram_at;
+        for (auto input : inputs[node])
+        {
+          group.push_back(files[input]);
+          at = std::max(at, done_at[input]);
+        }
+        // at the tail of the dag free devices take the output, so it is written behind,
+        // and the forecast reads of the inputs
+        const bool tail = launched + 1 == node_amount - leaf_amount;
+        // a merge still queued when another one failed is not started
+        merges.push_back(exec.submit([&pool, &exec, &grant, &events, token = stop.get_token(), group = std::move(group), block = *block, node, at, tail]()
+        {
+          try
+          {
+            if (token.stop_requested())
+            {
+              throw std::runtime_error("merge_dag: merge is cancelled!");
+            }
+            auto th = pool.acquire_at(at);
+            auto out_th = tail ? pool.try_acquire_at(at) : std::nullopt;
+            auto ahead_th = out_th ? pool.try_acquire_at(at) : std::nullopt;
+            auto merged = merge< T >(th.get(), group, block, std::addressof(grant), std::addressof(exec), out_th ? out_th->get() : nullptr, ahead_th ? ahead_th->get() : nullptr);
+            const std::size_t finish = std::max({th->elapsed(), out_th ? (*out_th)->elapsed() : 0, ahead_th ? (*ahead_th)->elapsed() : 0});
+            // the last event lets the dispatcher return, nothing is touched after it
+            th.release();
+            out_th.reset();
+            ahead_th.reset();
+            events.push({node, merged, finish, nullptr});
+          }
+          catch (...)
+          {
+            events.push({node, fs::path(), 0, std::current_exception()});
+          }
+        }));
+        ++launched;
+        ++in_flight;
+      }
+
+      // nothing is left to start, the running merges may grow into freed ram
+      if (launched == node_amount - leaf_amount)
+      {
+        grant.open();
+      }
+      if (in_flight == 0)
+      {
+        if (!error && !ready.empty())
+        {
+          throw std::runtime_error("merge_dag: ram is too small for a block!");
+        }
+        break;
+      }
+
+      // a merge that waited for ram starts when the first of the merges ended here is done
+      auto batch = events.wait();
+      std::optional< std::size_t > freed_at = std::nullopt;
+      for (const auto & done : batch)
+      {
+        if (!done.error)
+        {
+          freed_at = std::min(freed_at.value_or(done.finish), done.finish);
+        }
+      }
+      if (starved && freed_at.has_value())
+      {
+        ram_at = std::max(ram_at, *freed_at);
+      }
+      starved = false;
+      for (auto & done : batch)
+      {
+        --in_flight;
+        grant.offer(node_block[done.node]);
+        if (done.error)
+        {
+          error = error ? error : done.error;
+          stop.request_stop();
+          continue;
+        }
+
+        files[done.node] = done.path;
+        done_at[done.node] = done.finish;
+        for (auto input : inputs[done.node])
+        {
+          utils::remove_file(files.release(input));
+        }
+        std::size_t next = parent[done.node];
+        if (next != node_amount && --waiting[next] == 0)
+        {
+          ready.push({node_level[next], next});
+        }
+      }
+    }
+  }
+  catch (...)
+  {
+    // the merges use the locals, so they are waited for,
+    // the files of the ones that ended meanwhile are dropped
+    stop.request_stop();
+    for (auto & task : merges)
+    {
+      task.wait();
+    }
+    for (auto & done : events.take())
+    {
+      if (!done.error)
+      {
+        utils::remove_file(done.path);
+      }
+    }
+    throw;
+  }
+
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+
+  file_handler dst;
+  for (auto node : current)
+  {
+    dst.push_back(files.release(node));
+  }
+
+  return std::make_pair(std::move(dst), rhandler.pick_ram());
+}
+
+template< bb::run_type T, bb::unit_writer< T > W >
+bb::unique_ram< T >
+bb::polyphase(file_handler src, tape_pool< T > & pool, std::size_t tape_amount, executor & exec, unique_ram< T > ram, W & dst, bool read_backward)
+{
+  if (tape_amount < 3)
+  {
+    throw std::runtime_error("polyphase: at least 3 tape handlers required!");
+  }
+  if (tape_amount > pool.size())
+  {
+    throw std::runtime_error("polyphase: tape amount is larger than the pool!");
+  }
+
+  if (src.size() < 2)
+  {
+    auto th = pool.acquire(0);
+    merge< T >(th.get(), src.view(0, src.size()), *ram, dst, nullptr, std::addressof(exec));
+    return ram;
+  }
+
+  // perfect distribution of the smallest level holding all runs:
+  // (a1, ..., ap) -> (a1 + a2, ..., a1 + ap, a1)
+  const std::size_t inputs = tape_amount - 1;
+  std::vector< std::size_t > target(inputs, 1);
+  while (std::accumulate(target.begin(), target.end(), std::size_t(0)) < src.size())
+  {
+    std::vector< std::size_t > next(inputs);
+    for (std::size_t j = 0; j + 1 < inputs; ++j)
+    {
+      next[j] = target[0] + target[j + 1];
+    }
+    next[inputs - 1] = target[0];
+    target = std::move(next);
+  }
+
+  // every tape is a device of its own, runs lie on it one after another,
+  // the device of a run is leased from the pool only while it is merged
+  std::vector< std::deque< tape_run< T > > > tapes(tape_amount);
+  std::vector< std::size_t > dummies(tape_amount, 0);
+  for (std::size_t i = 0, j = 0; i < src.size(); j = (j + 1) % inputs)
+  {
+    if (tapes[j].size() < target[j])
     {
-      ram[pos] = th->read();
-      if (th->get_pos() + 1 == th->size())
+      std::size_t begin = tapes[j].empty() ? 0 : tapes[j].back().begin + tapes[j].back().size;
+      std::optional< bool > descending = false;
+      if (read_backward)
       {
-        ++was_read;
-        break;
+        descending = std::nullopt;
       }
-      th->offset(1);
+      tapes[j].push_back({src[i], nullptr, begin, run_reader< T >(src[i]).size(), descending});
+      ++i;
     }
-
-    return was_read;
   }
-
-  template< unit_type T >
-  size_t
-  read_from_tape_to_ram(shared_tape_handler< T > th, size_t lhs, size_t rhs, size_t off, ram_view< T > ram)
+  // dummy runs are merged first when reading forward, the short runs of those merges are
+  // then the first to be read in the next phase, reading backward they are merged last
+  // in a phase, so its short runs lie on top of the output tape and are read first too
+  for (std::size_t j = 0; j < inputs; ++j)
   {
-    th->roll(off);
-    return read_from_tape_to_ram_without_roll(th, lhs, rhs, ram);
+    dummies[j] = target[j] - tapes[j].size();
   }
 
-  template< unit_type T >
-  shared_tape_handler< T >
-  take_tape_handler(shared_tape_handlers_view< T > src)
+  // reading backward takes the runs of a tape from its end, where the head
+  // stopped writing them, so no tape is rewound between the phases
+  auto pop_run = [&tapes, read_backward](std::size_t j)
   {
-    auto dst = find_if(src.begin(), src.end(), [](shared_tape_handler< T > th)
+    tape_run< T > run;
+    if (read_backward)
     {
-      return !th->is_reserved();
-    });
+      run = std::move(tapes[j].back());
+      tapes[j].pop_back();
+    }
+    else
+    {
+      run = std::move(tapes[j].front());
+      tapes[j].pop_front();
+    }
+    return run;
+  };
 
-    if (dst == src.end())
+  file_handler runs = std::move(src);
+  std::size_t out = inputs;
+  std::size_t out_origin = 0;
+  while (true)
+  {
+    std::size_t merges = std::numeric_limits< std::size_t >::max();
+    bool last = tapes[out].empty() && dummies[out] == 0;
+    for (std::size_t j = 0; j < tape_amount; ++j)
+    {
+      if (j != out)
+      {
+        merges = std::min(merges, tapes[j].size() + dummies[j]);
+        last = last && (tapes[j].size() + dummies[j] == 1);
+      }
+    }
+    if (merges == 0)
     {
-      throw runtime_error("can't find available tape handler!");
+      throw std::runtime_error("polyphase: broken run distribution!");
     }
 
-    (*dst)->take();
+    for (std::size_t m = 0; m < merges; ++m)
+    {
+      std::vector< tape_run< T > > group;
+      std::vector< tape_lease< T > > leases;
+      std::size_t size = 0;
+      std::size_t ascending = 0;
+      std::size_t descending_runs = 0;
+      for (std::size_t j = 0; j < tape_amount; ++j)
+      {
+        if (j == out)
+        {
+          continue;
+        }
+        if (dummies[j] != 0 && (!read_backward || dummies[j] >= merges - m))
+        {
+          --dummies[j];
+          continue;
+        }
+        group.push_back(pop_run(j));
+        leases.push_back(pool.acquire(j));
+        group.back().th = leases.back().get();
+        size = size + group.back().size;
+        if (group.back().descending.has_value())
+        {
+          ascending = ascending + (*group.back().descending ? 0 : 1);
+          descending_runs = descending_runs + (*group.back().descending ? 1 : 0);
+        }
+      }
+
+      // the output order is the one most of the group reads backward in, on a tie
+      // the runs of the output tape alternate, the final run always goes out ascending
+      bool descending = ascending > descending_runs;
+      if (ascending == descending_runs)
+      {
+        descending = tapes[out].empty() || !*tapes[out].back().descending;
+      }
+      descending = read_backward && !last && descending;
+      auto out_th = pool.acquire(out);
+
+      if (last)
+      {
+        merge< T >(std::span< const tape_run< T > >(group), false, out_th.get(), out_origin, *ram, dst, std::addressof(exec));
+        return ram;
+      }
+      if (group.empty())
+      {
+        ++dummies[out];
+        continue;
+      }
+
+      auto merged = merge< T >(std::span< const tape_run< T > >(group), descending, out_th.get(), out_origin, *ram, std::addressof(exec));
+      for (const auto & run : group)
+      {
+        utils::remove_file(run.path);
+      }
+      runs.push_back(merged);
+      tapes[out].push_back({merged, nullptr, out_origin, size, descending});
+      out_origin = out_origin + size;
+    }
 
-    return *dst;
+    // the input tape that ran dry is the output of the next phase
+    for (std::size_t j = 0; j < tape_amount; ++j)
+    {
+      if (j != out && tapes[j].empty() && dummies[j] == 0)
+      {
+        out = j;
+        out_origin = 0;
+        break;
+      }
+    }
   }
 }
 
-namespace bb
+template< bb::run_type T, typename R >
+bb::file_handler
+bb::split_src_unit(R & src, shared_tape_handler< T > th, ram_view< T > ram)
 {
-  template< unit_type T >
-  using shared_ths_view = shared_tape_handlers_view< T >;
+  if (!th)
+  {
+    throw std::runtime_error("split_src_unit: tape_handler is null!");
+  }
+  if (!th->is_available())
+  {
+    throw std::runtime_error("split_src_unit: tape_handler is unavailable!");
+  }
 
-  template< unit_type T >
-  std::pair< file_handler, unique_ram< T > >
-  strategy(const file_handler & src, shared_ths_view< T > ths, unique_ram< T > ram, std::size_t blk, std::size_t threads);
+  file_handler dst;
+  if (ram.empty())
+  {
+    throw std::runtime_error("split_src_unit: ram size is zero!");
+  }
 
-  template< unit_type T >
-  std::tuple< file_handler, unique_unit< T >, unique_ram< T > >
-  split_src_unit(unique_unit< T > src, shared_tape_handler< T > th, std::size_t file_amount, unique_ram< T > ram);
+  auto io_tape = make_io_buffer< T >(ram.size());
+  std::size_t in_origin = 0;
+  std::size_t out_origin = 0;
+  while (!src.done())
+  {
+    std::size_t was_read = read_from_reader_to_ram< T >(th, src, ram, io_tape, in_origin);
+    if (was_read == 0)
+    {
+      break;
+    }
 
-  template< unit_type T >
-  fs::path
-  merge(shared_tape_handler< T > th, const fs::path & lhs, const fs::path & rhs, ram_view< T > ram);
+    std::sort(ram.begin(), ram.begin() + was_read);
+
+    auto tmp_file = utils::create_tmp_file(run_extension);
+    dst.push_back(tmp_file);
+
+    run_writer< T > run(tmp_file);
+    write_from_ram_to_writer< T >(th, ram.first(was_read), run, io_tape, out_origin, stream_head< T >(th, 1));
+    run.close();
+  }
+
+  return dst;
 }
 
-template< bb::unit_type T >
+template< bb::run_type T >
 std::pair< bb::file_handler, bb::unique_ram< T > >
-bb::strategy(const file_handler & src, shared_ths_view< T > ths, unique_ram< T > ram, std::size_t blk, std::size_t threads)
+bb::split_src_unit(json_tape_reader< T > & src, shared_tape_handler< T > th, unique_ram< T > ram)
+{
+  file_handler dst = split_src_unit< T >(src, th, ram_view< T >(*ram));
+  return std::make_pair(std::move(dst), std::move(ram));
+}
+
+template< bb::run_type T, typename R >
+bb::file_handler
+bb::replacement_selection(R & src, shared_tape_handler< T > th, ram_view< T > ram)
 {
-  if (ths.size() < 1)
+  if (!th)
+  {
+    throw std::runtime_error("replacement_selection: tape_handler is null!");
+  }
+  if (!th->is_available())
   {
-    throw std::runtime_error("strategy: tape handlers amount is too small!");
+    throw std::runtime_error("replacement_selection: tape_handler is unavailable!");
+  }
+  if (ram.size() < 3)
+  {
+    throw std::runtime_error("replacement_selection: ram size is too small!");
   }
 
-  file_handler dst;
-  ram_handler rhandler(std::move(ram), blk);
+  /*
+    ram layout: | input buffer | output buffer | heap ... | next run |
+    values smaller than the last written one can't join the current run,
+    they are parked at the back of the heap area and form the next heap,
+    runs average twice the heap, so the io buffers are kept to a small share
+  */
+  const std::size_t io_size = std::max< std::size_t >(1, std::min(io_block_size, ram.size() / 64));
+  ram_view< T > in_ram = ram.first(io_size);
+  ram_view< T > out_ram = ram.subspan(io_size, io_size);
+  ram_view< T > heap = ram.subspan(2 * io_size);
+  const auto greater = std::greater< T >();
 
-  using sort_tuple = std::tuple< std::future< fs::path >, shared_tape_handler< T >, ram_view< T > >;
-  std::queue< sort_tuple > sort_queue;
-  for (std::size_t i = 0; i < src.size(); i = i + 2)
+  auto io_tape = make_io_buffer< T >(ram.size());
+  std::size_t in_origin = 0;
+  std::size_t out_origin = 0;
+  std::size_t in_pos = 0;
+  std::size_t in_end = 0;
+  std::size_t out_pos = 0;
+  auto next_input = [&](T & value)
   {
-    if (sort_queue.size() == threads)
+    if (in_pos == in_end)
+    {
+      in_end = read_from_reader_to_ram< T >(th, src, in_ram, io_tape, in_origin);
+      in_pos = 0;
+    }
+    if (in_pos == in_end)
     {
-      auto future_2th = std::move(sort_queue.front());
-      sort_queue.pop();
+      return false;
+    }
+
+    value = in_ram[in_pos++];
+    return true;
+  };
+
+  std::size_t heap_size = 0;
+  std::size_t next_size = 0;
+  T value{};
+  while (heap_size < heap.size() && next_input(value))
+  {
+    heap[heap_size++] = value;
+  }
+  std::make_heap(heap.begin(), heap.begin() + heap_size, greater);
+
+  file_handler dst;
+  while (heap_size != 0)
+  {
+    auto tmp_file = utils::create_tmp_file(run_extension);
+    dst.push_back(tmp_file);
+    run_writer< T > run(tmp_file);
 
-      auto file = std::move(std::get< 0 >(future_2th));
-      auto th = std::get< 1 >(future_2th);
-      auto block = std::get< 2 >(future_2th);
+    while (heap_size != 0)
+    {
+      std::pop_heap(heap.begin(), heap.begin() + heap_size, greater);
+      T top = heap[heap_size - 1];
+      out_ram[out_pos++] = top;
+      if (out_pos == out_ram.size())
+      {
+        write_from_ram_to_writer< T >(th, out_ram, run, io_tape, out_origin, stream_head< T >(th, 1));
+        out_pos = 0;
+      }
 
-      dst.push_back(file.get());
-      th->free();
-      rhandler.free_ram_block(block);
+      if (!next_input(value))
+      {
+        --heap_size;
+      }
+      else if (value >= top)
+      {
+        heap[heap_size - 1] = value;
+        std::push_heap(heap.begin(), heap.begin() + heap_size, greater);
+      }
+      else
+      {
+        --heap_size;
+        ++next_size;
+        heap[heap.size() - next_size] = value;
+      }
     }
-    auto th = take_tape_handler< T >(ths);
-    const auto & lhs = src[i];
-    const auto & rhs = src[i + 1];
-    auto block = rhandler.take_ram_block();
-    auto tmp_future = std::async(std::launch::async, merge< T >,
-      th,
-      std::cref(lhs),
-      std::cref(rhs),
-      block
-    );
 
-    auto to_push = std::make_tuple(std::move(tmp_future), th, block);
-    sort_queue.push(std::move(to_push));
+    write_from_ram_to_writer< T >(th, out_ram.first(out_pos), run, io_tape, out_origin, stream_head< T >(th, 1));
+    out_pos = 0;
+    run.close();
+
+    std::copy(heap.end() - next_size, heap.end(), heap.begin());
+    heap_size = next_size;
+    next_size = 0;
+    std::make_heap(heap.begin(), heap.begin() + heap_size, greater);
   }
 
-  while (!sort_queue.empty())
+  return dst;
+}
+
+template< bb::run_type T >
+std::pair< bb::file_handler, bb::unique_ram< T > >
+bb::replacement_selection(json_tape_reader< T > & src, shared_tape_handler< T > th, unique_ram< T > ram)
+{
+  file_handler dst = replacement_selection< T >(src, th, ram_view< T >(*ram));
+  return std::make_pair(std::move(dst), std::move(ram));
+}
+
+template< bb::run_type T >
+std::pair< bb::file_handler, bb::unique_ram< T > >
+bb::split_parallel(json_tape_reader< T > & src, tape_pool< T > & pool, executor & exec, unique_ram< T > ram, run_generation runs)
+{
+  if (pool.size() == 0)
   {
-    auto future_2th = std::move(sort_queue.front());
-    auto file = std::move(std::get< 0 >(future_2th));
-    auto th = std::get< 1 >(future_2th);
-    auto block = std::get< 2 >(future_2th);
+    throw std::runtime_error("split_parallel: tape handlers are empty!");
+  }
 
-    dst.push_back(file.get());
-    th->free();
-    rhandler.free_ram_block(block);
+  // every device takes its turn of io blocks of the source and splits them with its own share of ram,
+  // the workers wait for each other's turns, so all of them must run at once
+  const std::size_t threads = std::max< std::size_t >(1, std::min({pool.size(), exec.size(), ram->size() / min_split_block}));
+  const std::size_t block_size = ram->size() / threads;
+  ram_handler< T > rhandler(std::move(ram), block_size);
+  shared_reader< T, json_tape_reader< T > > shared_src(src, threads);
+
+  // all the workers read the source in turns, so their devices are leased
+  // before any of them starts, all at the tape time the split starts at
+  const std::size_t begin = pool.elapsed();
+  using split_future = std::pair< std::future< file_handler >, ram_view< T > >;
+  std::vector< split_future > split_queue;
+  for (std::size_t i = 0; i < threads; ++i)
+  {
+    auto lease = pool.acquire_at(begin);
+    auto block = rhandler.take_ram_block();
+    auto tmp_future = exec.submit([&shared_src, lease = std::move(lease), block, runs, i]() mutable
+    {
+      auto th = std::move(lease);
+      shared_reader_seat< T, json_tape_reader< T > > seat(shared_src, i);
+      if (runs == run_generation::replacement_selection)
+      {
+        return replacement_selection< T >(seat, th.get(), block);
+      }
+      return split_src_unit< T >(seat, th.get(), block);
+    });
 
-    sort_queue.pop();
+    split_queue.push_back(std::make_pair(std::move(tmp_future), block));
   }
 
-  if (dst.size() % 2 != 0 && dst.size() != 1)
+  // a failed worker leaves its seat, the rest are waited for, they use the locals
+  file_handler dst;
+  std::exception_ptr error = nullptr;
+  for (auto & [future, block] : split_queue)
   {
-    auto tmp_file = utils::create_tmp_file();
-    write_tape_to_file< T >(tmp_file, {}); 
-    dst.push_back(tmp_file);
+    try
+    {
+      file_handler part = future.get();
+      for (std::size_t i = 0; i < part.size(); ++i)
+      {
+        dst.push_back(part.release(i));
+      }
+    }
+    catch (...)
+    {
+      error = error ? error : std::current_exception();
+    }
+    rhandler.free_ram_block(block);
+  }
+  if (error)
+  {
+    std::rethrow_exception(error);
   }
 
-  return std::make_pair(std::move(dst), std::move(rhandler.pick_ram()));
+  return std::make_pair(std::move(dst), rhandler.pick_ram());
 }
 
-template< bb::unit_type T >
-std::tuple< bb::file_handler, bb::unique_unit< T >, bb::unique_ram< T > >
-bb::split_src_unit(unique_unit< T > src, shared_tape_handler< T > th, std::size_t file_amount, unique_ram< T > ram)
+template< bb::run_type T >
+std::pair< bb::file_handler, bb::unique_ram< T > >
+bb::natural_runs(json_tape_reader< T > & src, shared_tape_handler< T > th, unique_ram< T > ram, const fs::path & dst)
 {
   if (!th)
   {
-    throw std::runtime_error("split_src_unit: tape_handler is null!");
+    throw std::runtime_error("natural_runs: tape_handler is null!");
   }
   if (!th->is_available())
   {
-    throw std::runtime_error("split_src_unit: tape_handler is unavailable!");
+    throw std::runtime_error("natural_runs: tape_handler is unavailable!");
+  }
+  if (ram->size() < 3)
+  {
+    throw std::runtime_error("natural_runs: ram size is too small!");
   }
 
-  file_handler dst;
-  const std::size_t ram_size = ram->size();
+  /*
+    ram layout: | output buffer | pending ... | read area ... |
+    the source is cut into ascending and descending natural runs (descending
+    ones are reversed), the part of each natural run that is not less than the
+    last written value extends the current run, the rest is kept pending in ram
+    and spilled as one sorted run when the read area runs out, the current run
+    is written straight into dst, so a sorted source makes no run files
+  */
+  const std::size_t io_size = std::max< std::size_t >(1, std::min(io_block_size, ram->size() / 8));
+  ram_view< T > out_ram = ram_view< T >(*ram).first(io_size);
+  ram_view< T > work = ram_view< T >(*ram).subspan(io_size);
+
+  auto io_tape = make_io_buffer< T >(ram->size());
+  // the source is read from the front of the device tape, runs are written over the part already read
+  std::size_t in_origin = 0;
+  std::size_t out_origin = 0;
+  file_handler runs;
+  json_tape_writer< T > current(dst);
+  bool started = false;
+  std::size_t out_pos = 0;
+  std::size_t pending = 0;
+  T last{};
 
-  std::size_t src_offset = 0;
-  for (std::size_t i = 0; i < file_amount; ++i)
+  auto append = [&](ram_view< T > values)
   {
-    auto tmp_file = utils::create_tmp_file();
-    dst.push_back(tmp_file);
+    while (!values.empty())
+    {
+      std::size_t step = std::min(values.size(), out_ram.size() - out_pos);
+      std::copy(values.begin(), values.begin() + step, out_ram.begin() + out_pos);
+      out_pos = out_pos + step;
+      values = values.subspan(step);
+      if (out_pos == out_ram.size())
+      {
+        write_from_ram_to_writer< T >(th, out_ram, current, io_tape, out_origin, stream_head< T >(th, 1));
+        out_pos = 0;
+      }
+    }
+  };
+  auto spill_pending = [&]()
+  {
+    if (pending == 0)
+    {
+      return;
+    }
+
+    ram_view< T > values = work.first(pending);
+    std::sort(values.begin(), values.end());
+    pending = 0;
+
+    auto tmp_file = utils::create_tmp_file(run_extension);
+    runs.push_back(tmp_file);
+    run_writer< T > run(tmp_file);
+    write_from_ram_to_writer< T >(th, values, run, io_tape, out_origin, stream_head< T >(th, 1));
+    run.close();
+  };
 
-    if (src_offset == src->size())
+  // the tail of the area is carried into the next read, so an outlier at the
+  // area end is still compared against the natural run that follows it
+  std::size_t carry = 0;
+  while (true)
+  {
+    if (work.size() - pending - carry < io_size)
     {
-      write_tape_to_file< T >(tmp_file, {});
-      continue;
+      std::size_t from = pending;
+      spill_pending();
+      std::copy(work.begin() + from, work.begin() + from + carry, work.begin());
     }
-    th->setup_tape(std::move(src));
-    std::size_t was_read = read_from_tape_to_ram< T >(th, 0, ram_size, src_offset, *ram);
-    src_offset = src_offset + was_read;
-    src = th->release_tape();
 
-    std::sort(ram->begin(), ram->begin() + was_read);
+    ram_view< T > area = work.subspan(pending);
+    std::size_t was_read = read_from_reader_to_ram< T >(th, src, area.subspan(carry), io_tape, in_origin);
+    if (was_read == 0 && carry == 0)
+    {
+      break;
+    }
+    const std::size_t total = carry + was_read;
 
-    auto tmp_tape = std::make_unique< unit< T > >(was_read);
-    th->setup_tape(std::move(tmp_tape));
-    for (std::size_t i = 0; i < was_read; ++i)
+    auto scan = [&](std::size_t begin)
     {
-      th->write((*ram)[i]);
-      if (th->get_pos() + 1 >= th->size())
+      std::size_t end = begin + 1;
+      if (end < total && area[end] < area[begin])
       {
-        break;
+        while (end < total && area[end] < area[end - 1])
+        {
+          ++end;
+        }
+        std::reverse(area.begin() + begin, area.begin() + end);
+        return end;
+      }
+
+      while (end < total && !(area[end] < area[end - 1]))
+      {
+        ++end;
+      }
+      return end;
+    };
+
+    carry = 0;
+    std::size_t begin = 0;
+    std::size_t end = scan(begin);
+    while (begin < total)
+    {
+      std::size_t next_end = end < total ? scan(end) : end;
+      if (end == total && was_read != 0)
+      {
+        carry = std::min(end - begin, io_size);
+        end = end - carry;
+        next_end = end;
+        if (begin == end)
+        {
+          break;
+        }
+      }
+
+      auto first = area.begin() + begin;
+      auto stop = area.begin() + end;
+      if (!started)
+      {
+        started = true;
+        last = *first;
+      }
+      auto split = std::lower_bound(first, stop, last);
+
+      // a tail above the next natural run is left out if that keeps fewer values pending
+      auto cut = stop;
+      if (end < next_end && split != stop)
+      {
+        auto next = std::lower_bound(stop, area.begin() + next_end, last);
+        if (next != area.begin() + next_end)
+        {
+          auto tail = std::upper_bound(split, stop, *next);
+          auto kept = std::lower_bound(next, area.begin() + next_end, *(stop - 1));
+          if (stop - tail <= kept - next)
+          {
+            cut = tail;
+          }
+        }
+      }
+
+      if (split != cut)
+      {
+        append(ram_view< T >(split, cut));
+        last = *(cut - 1);
       }
-      th->offset(1);
+
+      // out of order values are moved next to the pending ones
+      auto pending_end = std::copy(first, split, work.begin() + pending);
+      pending = std::copy(cut, stop, pending_end) - work.begin();
+      begin = end;
+      end = next_end;
+    }
+
+    std::copy(area.begin() + total - carry, area.begin() + total, work.begin() + pending);
+  }
+
+  spill_pending();
+  write_from_ram_to_writer< T >(th, out_ram.first(out_pos), current, io_tape, out_origin, stream_head< T >(th, 1));
+  current.close();
+
+  // with other runs to merge with, the current run is on the device tape already,
+  // only its file changes from dst to a run
+  if (runs.size() != 0)
+  {
+    auto tmp_file = utils::create_tmp_file(run_extension);
+    runs.push_back(tmp_file);
+    run_writer< T > run(tmp_file);
+    json_tape_reader< T > written(dst);
+    ram_view< T > buffer = *ram;
+    for (std::size_t got = written.read(buffer); got != 0; got = written.read(buffer))
+    {
+      run.write(buffer.first(got));
     }
-    tmp_tape = th->release_tape();
-    write_tape_to_file< T >(tmp_file, *tmp_tape);
+    run.close();
   }
 
-  return std::make_tuple(std::move(dst), std::move(src), std::move(ram));
+  return std::make_pair(std::move(runs), std::move(ram));
 }
 
-template< bb::unit_type T >
-bb::fs::path
-bb::merge(shared_tape_handler< T > th, const fs::path & lhs, const fs::path & rhs, ram_view< T > ram)
+template< bb::run_type T, bb::unit_writer< T > W >
+void
+bb::merge(shared_tape_handler< T > th, std::span< const fs::path > src, ram_view< T > ram, W & dst, ram_grant< T > * grant, executor * exec, shared_tape_handler< T > out_th, shared_tape_handler< T > ahead_th)
 {
   if (!th)
   {
@@ -215,132 +1849,238 @@ bb::merge(shared_tape_handler< T > th, const fs::path & lhs, const fs::path & rh
   {
     throw std::runtime_error("merge: tape_handler is unavailable!");
   }
-  if (ram.size() < 2)
+  if (ram.size() < src.size() + 1)
   {
     throw std::runtime_error("merge: ram size is too small!");
   }
 
-  auto lhs_tape = std::make_unique< unit< T > >(read_tape_from_file< T >(lhs));
-  auto rhs_tape = std::make_unique< unit< T > >(read_tape_from_file< T >(rhs));
-  auto dst_tape = std::make_unique< unit< T > >(lhs_tape->size() + rhs_tape->size());
+  if (out_th && !out_th->is_available())
+  {
+    throw std::runtime_error("merge: output tape_handler is unavailable!");
+  }
+  if (ahead_th && (!ahead_th->is_available() || ahead_th == th || ahead_th == out_th))
+  {
+    throw std::runtime_error("merge: forecast tape_handler is unavailable!");
+  }
 
-  const std::size_t lhs_size = lhs_tape->size();
-  const std::size_t rhs_size = rhs_tape->size();
-  const std::size_t dst_size = dst_tape->size();
+  // inputs lie one after another on the device tape, the output follows them
+  // or starts the tape of its own device
+  std::vector< merge_input< T > > inputs;
+  inputs.reserve(src.size());
+  std::size_t origin = 0;
+  for (const auto & path : src)
+  {
+    inputs.push_back({th, run_reader< T >(path), origin, false, false});
+    origin = origin + inputs.back().run.size();
+  }
 
-  std::size_t lhs_pos = 0;
-  std::size_t rhs_pos = 0;
-  std::size_t dst_pos = 0;
+  if (out_th)
+  {
+    merge_inputs< T, std::less< T > >(inputs, out_th, 0, ram, dst, grant, exec, ahead_th);
+  }
+  else
+  {
+    merge_inputs< T, std::less< T > >(inputs, th, origin, ram, dst, grant, exec, ahead_th);
+  }
+}
 
-  std::size_t to_write_lhs = 0;
-  std::size_t to_write_rhs = 0;
+template< bb::run_type T >
+bb::fs::path
+bb::merge(shared_tape_handler< T > th, std::span< const fs::path > src, ram_view< T > ram, ram_grant< T > * grant, executor * exec, shared_tape_handler< T > out_th, shared_tape_handler< T > ahead_th)
+{
+  auto dst = utils::atomic_create_tmp_file(run_extension);
+  try
+  {
+    run_writer< T > out(dst);
+    merge< T >(th, src, ram, out, grant, exec, out_th, ahead_th);
+    out.close();
+  }
+  catch (...)
+  {
+    utils::remove_file(dst);
+    throw;
+  }
 
-  ram_view< T > lhs_ram{};
-  ram_view< T > rhs_ram{};
+  return dst;
+}
 
-  std::size_t lhs_ram_pos = 0;
-  std::size_t rhs_ram_pos = 0;
+template< bb::run_type T, bb::unit_writer< T > W >
+void
+bb::merge(std::span< const tape_run< T > > src, bool descending, shared_tape_handler< T > th, std::size_t origin, ram_view< T > ram, W & dst, executor * exec)
+{
+  if (!th)
+  {
+    throw std::runtime_error("merge: tape_handler is null!");
+  }
+  if (ram.size() < src.size() + 1)
+  {
+    throw std::runtime_error("merge: ram size is too small!");
+  }
 
-  while (lhs_pos < lhs_size && rhs_pos < rhs_size)
+  std::vector< merge_input< T > > inputs;
+  inputs.reserve(src.size());
+  for (const auto & run : src)
   {
-    if (to_write_lhs == 0 && to_write_rhs == 0)
+    if (!run.th || !run.th->is_available())
     {
-      auto tmp_lhs_size = lhs_size - lhs_pos;
-      auto tmp_rhs_size = rhs_size - rhs_pos;
-      auto ram_mid = balance_ram_block(ram.size(), tmp_lhs_size, tmp_rhs_size);
-      lhs_ram = ram.subspan(0, ram_mid);
-      rhs_ram = ram.subspan(ram_mid, ram.size() - ram_mid);
-      assert(lhs_ram.size() + rhs_ram.size() == ram.size());
+      throw std::runtime_error("merge: tape_handler is unavailable!");
     }
 
-    if (lhs_ram_pos == to_write_lhs)
+    merge_input< T > in{run.th, run_reader< T >(run.path), run.begin, true, !descending};
+    if (run.descending.has_value())
     {
-      th->setup_tape(std::move(lhs_tape));
-      to_write_lhs = read_from_tape_to_ram< T >(th, 0, lhs_ram.size(), lhs_pos, lhs_ram);
-      lhs_tape = th->release_tape();
-      lhs_ram_pos = 0;
+      in.backward = *run.descending != descending;
+      in.reversed = false;
     }
-
-    if (rhs_ram_pos == to_write_rhs)
+    if (in.backward)
     {
-      th->setup_tape(std::move(rhs_tape));
-      to_write_rhs = read_from_tape_to_ram< T >(th, 0, rhs_ram.size(), rhs_pos, rhs_ram);
-      rhs_tape = th->release_tape();
-      rhs_ram_pos = 0;
+      in.origin = in.origin + in.run.size();
     }
+    inputs.push_back(std::move(in));
+  }
 
-    th->setup_tape(std::move(dst_tape));
-    th->roll(dst_pos);
-    while (lhs_ram_pos < to_write_lhs && rhs_ram_pos < to_write_rhs)
-    {
-      auto lhs_value = lhs_ram[lhs_ram_pos];
-      auto rhs_value = rhs_ram[rhs_ram_pos];
-      if (lhs_value <= rhs_value)
-      {
-        th->write(lhs_value);
-        ++lhs_pos;
-        ++lhs_ram_pos;
-      }
-      else
-      {
-        th->write(rhs_value);
-        ++rhs_pos;
-        ++rhs_ram_pos;
-      }
+  if (descending)
+  {
+    merge_inputs< T, std::greater< T > >(inputs, th, origin, ram, dst, nullptr, exec);
+  }
+  else
+  {
+    merge_inputs< T, std::less< T > >(inputs, th, origin, ram, dst, nullptr, exec);
+  }
+}
 
-      th->offset_if_possible(1);
-      ++dst_pos;
-    }
-    dst_tape = th->release_tape();
+template< bb::run_type T >
+bb::fs::path
+bb::merge(std::span< const tape_run< T > > src, bool descending, shared_tape_handler< T > th, std::size_t origin, ram_view< T > ram, executor * exec)
+{
+  auto dst = utils::atomic_create_tmp_file(run_extension);
+  try
+  {
+    run_writer< T > out(dst);
+    merge< T >(src, descending, th, origin, ram, out, exec);
+    out.close();
+  }
+  catch (...)
+  {
+    utils::remove_file(dst);
+    throw;
+  }
+
+  return dst;
+}
+
+template< bb::run_type T >
+std::vector< std::size_t >
+bb::co_rank(std::span< const fs::path > src, std::size_t rank)
+{
+  std::vector< run_reader< T > > runs;
+  std::size_t total = 0;
+  for (const auto & path : src)
+  {
+    runs.emplace_back(path);
+    total = total + runs.back().size();
+  }
+  if (rank > total)
+  {
+    throw std::runtime_error("co_rank: rank is out of runs!");
   }
 
-  while (lhs_pos < lhs_size)
+  return select_rank< T >(runs, rank);
+}
+
+template< bb::run_type T >
+void
+bb::merge_parallel(tape_pool< T > & pool, executor & exec, std::span< const fs::path > src, ram_view< T > ram, std::size_t parts, json_tape_writer< T > & dst)
+{
+  if (parts == 0)
+  {
+    throw std::runtime_error("merge_parallel: parts amount is zero!");
+  }
+  if (ram.size() / parts < src.size() + 1)
+  {
+    throw std::runtime_error("merge_parallel: ram size is too small!");
+  }
+  if (parts == 1)
   {
-    th->setup_tape(std::move(lhs_tape));
-    to_write_lhs = read_from_tape_to_ram< T >(th, 0, ram.size(), lhs_pos, ram);
-    lhs_tape = th->release_tape();
-    lhs_ram_pos = 0;
+    auto th = pool.acquire();
+    auto out_th = pool.try_acquire_for(std::chrono::milliseconds(0));
+    auto ahead_th = out_th ? pool.try_acquire_for(std::chrono::milliseconds(0)) : std::nullopt;
+    merge< T >(th.get(), src, ram, dst, nullptr, std::addressof(exec), out_th ? out_th->get() : nullptr, ahead_th ? ahead_th->get() : nullptr);
+    return;
+  }
 
-    th->setup_tape(std::move(dst_tape));
-    th->roll(dst_pos);
-    while (lhs_ram_pos < to_write_lhs)
-    {
-      auto value = ram[lhs_ram_pos];
-      th->write(value);
-      ++lhs_pos;
-      ++lhs_ram_pos;
-      ++dst_pos;
-      th->offset_if_possible(1);
-    }
-    dst_tape = th->release_tape();
+  std::vector< run_reader< T > > runs;
+  std::size_t total = 0;
+  for (const auto & path : src)
+  {
+    runs.emplace_back(path);
+    total = total + runs.back().size();
   }
 
-  while (rhs_pos < rhs_size)
+  // bounds[p] is where part p starts in every run
+  std::vector< std::vector< std::size_t > > bounds;
+  for (std::size_t p = 0; p <= parts; ++p)
   {
-    th->setup_tape(std::move(rhs_tape));
-    to_write_rhs = read_from_tape_to_ram< T >(th, 0, ram.size(), rhs_pos, ram);
-    rhs_tape = th->release_tape();
-    rhs_ram_pos = 0;
+    bounds.push_back(select_rank< T >(runs, total * p / parts));
+  }
 
-    th->setup_tape(std::move(dst_tape));
-    th->roll(dst_pos);
-    while (rhs_ram_pos < to_write_rhs)
+  // the room of a part in dst is as long as the text of its values
+  std::vector< json_tape_room > rooms;
+  for (std::size_t p = 0; p < parts; ++p)
+  {
+    std::uint64_t bytes = 0;
+    for (std::size_t j = 0; j < runs.size(); ++j)
     {
-      auto value = ram[rhs_ram_pos];
-      th->write(value);
-      ++rhs_pos;
-      ++rhs_ram_pos;
-      ++dst_pos;
-      th->offset_if_possible(1);
+      bytes = bytes + run_text_size< T >(runs[j], bounds[p][j], bounds[p + 1][j]);
     }
-    dst_tape = th->release_tape();
+    rooms.push_back(dst.reserve(total * (p + 1) / parts - total * p / parts, bytes));
   }
 
-  assert(dst_pos == dst_size);
+  // the parts all start at the tape time the merge starts at
+  const std::size_t begin = pool.elapsed();
+  const std::size_t block_size = ram.size() / parts;
+  std::vector< std::future< void > > merge_queue;
+  std::stop_source stop;
+  for (std::size_t p = 0; p < parts; ++p)
+  {
+    ram_view< T > block = ram.subspan(p * block_size, block_size);
+    merge_queue.push_back(exec.submit([&pool, &exec, src, &bounds, &rooms, p, block, begin]()
+    {
+      auto th = pool.acquire_at(begin);
+      std::vector< merge_input< T > > inputs;
+      inputs.reserve(src.size());
+      std::size_t origin = 0;
+      for (std::size_t j = 0; j < src.size(); ++j)
+      {
+        std::size_t first = bounds[p][j];
+        inputs.push_back({th.get(), run_reader< T >(src[j], first, bounds[p + 1][j] - first), origin, false, false});
+        origin = origin + inputs.back().run.size();
+      }
+
+      json_tape_part< T > out(rooms[p]);
+      merge_inputs< T, std::less< T > >(inputs, th.get(), origin, block, out, nullptr, std::addressof(exec));
+      out.close();
+    }, stop.get_token()));
+  }
 
-  auto dst = utils::atomic_create_tmp_file();
-  write_tape_to_file< T >(dst, *dst_tape);
-  return dst;
+  // after a failure the parts still queued are not started
+  std::exception_ptr error = nullptr;
+  for (auto & future : merge_queue)
+  {
+    try
+    {
+      future.get();
+    }
+    catch (...)
+    {
+      error = error ? error : std::current_exception();
+      stop.request_stop();
+    }
+  }
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
 }
 
 #endif
@@ -0,0 +1,35 @@
+#ifndef BBTAPE_TAPE_COST_HPP
+#define BBTAPE_TAPE_COST_HPP
+
+#include <cstddef>
+
+#include <bbtape/config.hpp>
+
+namespace bb
+{
+  /*
+    delays of device operations in milliseconds, positions are logical
+    positions on the device tape
+      uniform:  flat delay values, a roll costs on_roll whatever the distance
+      distance: a roll costs seek_overhead + distance * seek_per_element,
+                a single offset costs seek_per_element, block transfers are
+                streamed at read/write_per_element with no extra offset cost
+  */
+  class tape_cost
+  {
+    public:
+      tape_cost() = delete;
+      explicit tape_cost(const config & rhs);
+
+      double read(std::size_t amount, std::size_t offsets) const;
+      double write(std::size_t amount, std::size_t offsets) const;
+      double roll(std::size_t from, std::size_t to) const;
+      double offset() const;
+
+    private:
+      delay __delay;
+      cost_model __model;
+  };
+}
+
+#endif
@@ -7,8 +7,15 @@
 #include <fstream>
 #include <thread>
 #include <chrono>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <concepts>
+#include <type_traits>
 
 #include <bbtape/config.hpp>
+#include <bbtape/virtual_clock.hpp>
+#include <bbtape/tape_cost.hpp>
 #include <bbtape/utils.hpp>
 #include <bbtape/unit.hpp>
 #include <bbtape/json.hpp>
@@ -32,41 +39,131 @@ namespace
 
 namespace bb
 {
-  template< unit_type T >
+  /*
+    delay policies, how a device spends the time of its operations:
+    no_delay charges nothing (the delays of the config are ignored),
+    sleep_delay sleeps them, virtual_delay moves a virtual clock,
+    config_delay picks sleep or virtual by the delay mode of the config
+  */
+  struct no_delay {};
+  struct sleep_delay {};
+  struct virtual_delay {};
+  struct config_delay {};
+
+  template< typename D >
+  concept delay_policy = std::same_as< D, no_delay > || std::same_as< D, sleep_delay >
+    || std::same_as< D, virtual_delay > || std::same_as< D, config_delay >;
+
+  /*
+    locking policies: mutex_lock serialises the calls of several threads,
+    single_owner is for a device used by one thread at a time (or handed
+    over through a lock of its own), its lock does nothing
+  */
+  struct mutex_lock
+  {
+    using mutex = std::mutex;
+  };
+
+  struct single_owner
+  {
+    struct mutex
+    {
+      void lock() {}
+      void unlock() {}
+    };
+  };
+
+  template< typename L >
+  concept lock_policy = requires(typename L::mutex & m)
+  {
+    m.lock();
+    m.unlock();
+  };
+
+  // the sort devices are shared through their pool and take the delays from the config
+  template< unit_type T, delay_policy D = config_delay, lock_policy L = mutex_lock >
   class tape_handler
   {
     public:
       tape_handler() = delete;
-      tape_handler(config m_config);
+      tape_handler(config m_config, shared_virtual_clock clock = nullptr);
 
       T read();
       void write(T new_data);
+      // a roll to where the head already is costs nothing, any other one costs on_roll (or its distance)
       void roll(std::size_t new_pos);
       void offset(int direction);
       void offset_if_possible(int direction);
 
+      /*
+        bulk forms of read/offset(1) and write/offset_if_possible(1) under one lock,
+        n = min(span size, size() - get_pos()) values are moved, the head stops on
+        the next value or on the last one, one delay is charged for the whole block
+        (see tape_cost), with the uniform model:
+          read_block:  n * on_read + (n - (head stopped on the last value ? 1 : 0)) * on_offset
+          write_block: n * (on_write + on_offset)
+        on the device tape the head is left right behind the block, so the next
+        block of the same stream needs no roll
+      */
+      std::size_t read_block(std::span< T > dst);
+      std::size_t write_block(std::span< const T > src);
+      /*
+        reads n = min(span size, get_pos()) values in front of the head moving
+        backward (dst[0] is the value at get_pos() - 1), the head stops on the
+        last value read, charged like read_block in the other direction:
+          n * on_read + (n - (head stopped on the first value of the block ? 1 : 0)) * on_offset
+      */
+      std::size_t read_block_backward(std::span< T > dst);
+
+      /*
+        in virtual mode a task starts when the device is done with its last one
+        and no earlier than at, take() starts it at the shared clock, which only
+        fits a task that follows all the others, a task run beside others is given
+        the time its inputs are ready at by its dispatcher
+      */
       void take();
+      void take(std::size_t at);
       void free();
-      void setup_tape(unique_unit< T > rhs);
+      /*
+        origin is the logical position of the mounted block on the device tape,
+        the block is moved through the given head, every head keeps its own
+        position between blocks, roll is charged by the distance the head moves
+      */
+      void setup_tape(unique_unit< T > rhs, std::size_t origin = 0, std::size_t head = 0);
       unique_unit< T > release_tape();
 
       bool is_available() const;
       bool is_reserved() const;
       std::size_t get_pos() const;
       std::size_t size() const;
+      std::size_t heads() const;
+
+      // tape time charged by this device, in virtual mode the device time on the shared clock
+      std::size_t elapsed() const;
+      // rolls that really moved the head, a roll to where the head already is costs nothing
+      std::size_t roll_count() const;
 
     private:
-      mutable std::mutex __mutex;
+      using mutex_type = typename L::mutex;
+      static constexpr bool timed = !std::is_same_v< D, no_delay >;
+
+      mutable mutex_type __mutex;
 
       std::unique_ptr< unit< T > > __tape;
       std::size_t __pos;
+      std::size_t __origin;
+      std::vector< std::size_t > __heads;
+      std::size_t __head;
 
-      std::size_t __delay_on_read;
-      std::size_t __delay_on_write;
-      std::size_t __delay_on_roll;
-      std::size_t __delay_on_offset;
+      tape_cost __cost;
 
       bool __is_reserved;
+
+      shared_virtual_clock __clock;
+      double __elapsed;
+      std::size_t __rolls;
+
+      void charge(double delay);
   };
 
   template< unit_type T >
@@ -87,26 +184,44 @@ namespace bb
   write_tape_to_file(const fs::path & path, const unit< T > & rhs);
 }
 
-template< bb::unit_type T >
-bb::tape_handler< T >::tape_handler(config rhs):
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+bb::tape_handler< T, D, L >::tape_handler(config rhs, shared_virtual_clock clock):
   __mutex(),
   __tape(nullptr),
   __pos(0),
+  __origin(0),
+  __heads(rhs.m_phlimit.heads, 0),
+  __head(0),
 
-  __delay_on_read(rhs.m_delay.on_read),
-  __delay_on_write(rhs.m_delay.on_write),
-  __delay_on_roll(rhs.m_delay.on_roll),
-  __delay_on_offset(rhs.m_delay.on_offset),
+  __cost(rhs),
 
-  __is_reserved(false)
-{}
+  __is_reserved(false),
 
-template< bb::unit_type T >
+  __clock(std::move(clock)),
+  __elapsed(0),
+  __rolls(0)
+{
+  if (__heads.empty())
+  {
+    throw std::runtime_error("tape_handler: heads amount is zero!");
+  }
+  const bool virtual_time = std::is_same_v< D, virtual_delay >
+    || (std::is_same_v< D, config_delay > && rhs.m_delay.mode == delay_mode::virtual_time);
+  if (!__clock && virtual_time)
+  {
+    __clock = std::make_shared< virtual_clock >();
+  }
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 T
-bb::tape_handler< T >::read()
+bb::tape_handler< T, D, L >::read()
 {
-  std::lock_guard< std::mutex > lock(__mutex);
-  std::this_thread::sleep_for(std::chrono::milliseconds(__delay_on_read));
+  std::lock_guard< mutex_type > lock(__mutex);
+  if constexpr (timed)
+  {
+    charge(__cost.read(1, 0));
+  }
 
   if (!__tape)
   {
@@ -124,12 +239,15 @@ bb::tape_handler< T >::read()
   return (*__tape)[__pos];
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 void
-bb::tape_handler< T >::write(T new_data)
+bb::tape_handler< T, D, L >::write(T new_data)
 {
-  std::lock_guard< std::mutex > lock(__mutex);
-  std::this_thread::sleep_for(std::chrono::milliseconds(__delay_on_write));
+  std::lock_guard< mutex_type > lock(__mutex);
+  if constexpr (timed)
+  {
+    charge(__cost.write(1, 0));
+  }
 
   if (!__tape)
   {
@@ -147,13 +265,11 @@ bb::tape_handler< T >::write(T new_data)
   (*__tape)[__pos] = new_data;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 void
-bb::tape_handler< T >::roll(std::size_t new_pos)
+bb::tape_handler< T, D, L >::roll(std::size_t new_pos)
 {
-  std::lock_guard< std::mutex > lock(__mutex);
-  std::this_thread::sleep_for(std::chrono::milliseconds(__delay_on_roll));
-
+  std::lock_guard< mutex_type > lock(__mutex);
   if (!__tape)
   {
     throw std::runtime_error("can't roll tape! (no tape)");
@@ -163,15 +279,29 @@ bb::tape_handler< T >::roll(std::size_t new_pos)
     throw std::runtime_error("can't roll tape! (new position is greater than tape size)");
   }
 
+  // a roll that throws leaves the device time and the roll count as they were
+  if (__origin + new_pos != __heads[__head])
+  {
+    if constexpr (timed)
+    {
+      charge(__cost.roll(__heads[__head], __origin + new_pos));
+    }
+    __rolls = __rolls + 1;
+  }
+
   __pos = new_pos;
+  __heads[__head] = __origin + __pos;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 void
-bb::tape_handler< T >::offset(int direction)
+bb::tape_handler< T, D, L >::offset(int direction)
 {
-  std::lock_guard< std::mutex > lock(__mutex);
-  std::this_thread::sleep_for(std::chrono::milliseconds(__delay_on_offset));
+  std::lock_guard< mutex_type > lock(__mutex);
+  if constexpr (timed)
+  {
+    charge(__cost.offset());
+  }
 
   if (!__tape)
   {
@@ -187,14 +317,18 @@ bb::tape_handler< T >::offset(int direction)
   }
 
   __pos = __pos + direction;
+  __heads[__head] = __origin + __pos;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 void
-bb::tape_handler< T >::offset_if_possible(int direction)
+bb::tape_handler< T, D, L >::offset_if_possible(int direction)
 {
-  std::lock_guard< std::mutex > lock(__mutex);
-  std::this_thread::sleep_for(std::chrono::milliseconds(__delay_on_offset));
+  std::lock_guard< mutex_type > lock(__mutex);
+  if constexpr (timed)
+  {
+    charge(__cost.offset());
+  }
 
   if (!__tape)
   {
@@ -210,80 +344,195 @@ bb::tape_handler< T >::offset_if_possible(int direction)
   }
 
   __pos = __pos + direction;
+  __heads[__head] = __origin + __pos;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+std::size_t
+bb::tape_handler< T, D, L >::read_block(std::span< T > dst)
+{
+  std::lock_guard< mutex_type > lock(__mutex);
+  if (!__tape)
+  {
+    throw std::runtime_error("can't read tape block! (no tape)");
+  }
+  if (dst.empty())
+  {
+    return 0;
+  }
+  if (__pos >= __tape->size())
+  {
+    throw std::runtime_error("can't read tape block! (bad position)");
+  }
+
+  std::size_t amount = std::min(dst.size(), __tape->size() - __pos);
+  std::size_t offsets = __pos + amount == __tape->size() ? amount - 1 : amount;
+  if constexpr (timed)
+  {
+    charge(__cost.read(amount, offsets));
+  }
+
+  std::copy_n(__tape->begin() + __pos, amount, dst.begin());
+  __heads[__head] = __origin + __pos + amount;
+  __pos = __pos + offsets;
+  return amount;
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+std::size_t
+bb::tape_handler< T, D, L >::read_block_backward(std::span< T > dst)
+{
+  std::lock_guard< mutex_type > lock(__mutex);
+  if (!__tape)
+  {
+    throw std::runtime_error("can't read tape block backward! (no tape)");
+  }
+  if (dst.empty())
+  {
+    return 0;
+  }
+  if (__pos == 0 || __pos > __tape->size())
+  {
+    throw std::runtime_error("can't read tape block backward! (bad position)");
+  }
+
+  std::size_t amount = std::min(dst.size(), __pos);
+  std::size_t offsets = amount == __pos ? amount - 1 : amount;
+  if constexpr (timed)
+  {
+    charge(__cost.read(amount, offsets));
+  }
+
+  std::reverse_copy(__tape->begin() + (__pos - amount), __tape->begin() + __pos, dst.begin());
+  __pos = __pos - amount;
+  __heads[__head] = __origin + __pos;
+  return amount;
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+std::size_t
+bb::tape_handler< T, D, L >::write_block(std::span< const T > src)
+{
+  std::lock_guard< mutex_type > lock(__mutex);
+  if (!__tape)
+  {
+    throw std::runtime_error("can't write tape block! (no tape)");
+  }
+  if (src.empty())
+  {
+    return 0;
+  }
+  if (__pos >= __tape->size())
+  {
+    throw std::runtime_error("can't write tape block! (bad position)");
+  }
+
+  std::size_t amount = std::min(src.size(), __tape->size() - __pos);
+  if constexpr (timed)
+  {
+    charge(__cost.write(amount, amount));
+  }
+
+  std::copy_n(src.begin(), amount, __tape->begin() + __pos);
+  __heads[__head] = __origin + __pos + amount;
+  __pos = std::min(__pos + amount, __tape->size() - 1);
+  return amount;
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 void
-bb::tape_handler< T >::setup_tape(unique_unit< T > rhs)
+bb::tape_handler< T, D, L >::setup_tape(unique_unit< T > rhs, std::size_t origin, std::size_t head)
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  std::lock_guard< mutex_type > lock(__mutex);
+  if (head >= __heads.size())
+  {
+    throw std::runtime_error("can't setup tape! (bad head)");
+  }
+
   __tape = std::move(rhs);
   __pos = 0;
+  __origin = origin;
+  __head = head;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 void
-bb::tape_handler< T >::take()
+bb::tape_handler< T, D, L >::take()
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  take(__clock ? __clock->now() : 0);
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+void
+bb::tape_handler< T, D, L >::take(std::size_t at)
+{
+  std::lock_guard< mutex_type > lock(__mutex);
   if (__is_reserved)
   {
     throw std::runtime_error("can't take tape handler!");
   }
 
   __is_reserved = true;
+  if (__clock)
+  {
+    __elapsed = std::max(__elapsed, static_cast< double >(at));
+  }
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 void
-bb::tape_handler< T >::free()
+bb::tape_handler< T, D, L >::free()
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  std::lock_guard< mutex_type > lock(__mutex);
   if (__tape)
   {
     throw std::runtime_error("can't free with active tape!");
   }
 
   __is_reserved = false;
+  if (__clock)
+  {
+    __clock->advance_to(static_cast< std::size_t >(__elapsed));
+  }
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 bb::unique_unit< T >
-bb::tape_handler< T >::release_tape()
+bb::tape_handler< T, D, L >::release_tape()
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  std::lock_guard< mutex_type > lock(__mutex);
   return std::move(__tape);
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 bool
-bb::tape_handler< T >::is_available() const
+bb::tape_handler< T, D, L >::is_available() const
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  std::lock_guard< mutex_type > lock(__mutex);
   return !__tape;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 bool
-bb::tape_handler< T >::is_reserved() const
+bb::tape_handler< T, D, L >::is_reserved() const
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  std::lock_guard< mutex_type > lock(__mutex);
   return __is_reserved;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 std::size_t
-bb::tape_handler< T >::get_pos() const
+bb::tape_handler< T, D, L >::get_pos() const
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  std::lock_guard< mutex_type > lock(__mutex);
   return __pos;
 }
 
-template< bb::unit_type T >
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
 std::size_t
-bb::tape_handler< T >::size() const
+bb::tape_handler< T, D, L >::size() const
 {
-  std::lock_guard< std::mutex > lock(__mutex);
+  std::lock_guard< mutex_type > lock(__mutex);
   if (!__tape)
   {
     throw std::runtime_error("tape_handler::size: tape is null!");
@@ -292,6 +541,42 @@ bb::tape_handler< T >::size() const
   return __tape->size();
 }
 
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+std::size_t
+bb::tape_handler< T, D, L >::heads() const
+{
+  return __heads.size();
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+std::size_t
+bb::tape_handler< T, D, L >::elapsed() const
+{
+  std::lock_guard< mutex_type > lock(__mutex);
+  return static_cast< std::size_t >(__elapsed);
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+std::size_t
+bb::tape_handler< T, D, L >::roll_count() const
+{
+  std::lock_guard< mutex_type > lock(__mutex);
+  return __rolls;
+}
+
+template< bb::unit_type T, bb::delay_policy D, bb::lock_policy L >
+void
+bb::tape_handler< T, D, L >::charge(double delay)
+{
+  // the caller holds the lock, a virtual device only moves its own time
+  __elapsed = __elapsed + delay;
+  const bool sleeps = std::is_same_v< D, sleep_delay > || (std::is_same_v< D, config_delay > && !__clock);
+  if (sleeps && delay > 0)
+  {
+    std::this_thread::sleep_for(std::chrono::duration< double, std::milli >(delay));
+  }
+}
+
 template< bb::unit_type T >
 bb::unit< T >
 bb::read_tape_from_file(const fs::path & path)
@@ -0,0 +1,339 @@
+#ifndef BBTAPE_TAPE_POOL_HPP
+#define BBTAPE_TAPE_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <vector>
+#include <stdexcept>
+
+#include <bbtape/tape_handler.hpp>
+#include <bbtape/unit.hpp>
+
+namespace bb
+{
+  template< unit_type T >
+  class tape_pool;
+
+  /*
+    reserved device, the device is freed and handed back to its pool
+    when the lease is destroyed, a mounted block is dropped first
+  */
+  template< unit_type T >
+  class tape_lease
+  {
+    public:
+      tape_lease() = delete;
+      tape_lease(const tape_lease &) = delete;
+      tape_lease(tape_lease && rhs) noexcept;
+      tape_lease & operator=(const tape_lease &) = delete;
+      tape_lease & operator=(tape_lease && rhs) noexcept;
+      ~tape_lease();
+
+      const shared_tape_handler< T > & get() const;
+      tape_handler< T > * operator->() const;
+      std::size_t index() const;
+
+      void release();
+
+    private:
+      friend class tape_pool< T >;
+
+      tape_pool< T > * __pool;
+      std::size_t __index;
+
+      tape_lease(tape_pool< T > & pool, std::size_t index);
+  };
+
+  /*
+    the only way to get a device: acquire blocks until some device (or the
+    given one) is free, try_acquire_for gives up after the timeout,
+    returning leases wake the waiters, of the free devices the one done
+    the earliest is leased, the _at versions start the task at the logical
+    time at (see tape_handler::take)
+  */
+  template< unit_type T >
+  class tape_pool
+  {
+    public:
+      tape_pool() = delete;
+      explicit tape_pool(shared_tape_handlers_view< T > ths);
+      tape_pool(const tape_pool &) = delete;
+      tape_pool & operator=(const tape_pool &) = delete;
+
+      tape_lease< T > acquire();
+      tape_lease< T > acquire(std::size_t index);
+      std::optional< tape_lease< T > > try_acquire_for(std::chrono::milliseconds timeout);
+      tape_lease< T > acquire_at(std::size_t at);
+      std::optional< tape_lease< T > > try_acquire_at(std::size_t at);
+
+      std::size_t size() const;
+      std::size_t available() const;
+      // the latest time of the devices, when none is leased it is the end of all the tasks
+      std::size_t elapsed() const;
+
+    private:
+      friend class tape_lease< T >;
+
+      mutable std::mutex __mutex;
+      std::condition_variable __free_cv;
+      shared_tape_handlers< T > __ths;
+      std::vector< char > __busy;
+
+      std::optional< std::size_t > find_free() const;
+      tape_lease< T > lease(std::size_t index, std::optional< std::size_t > at = std::nullopt);
+      void give_back(std::size_t index);
+  };
+}
+
+template< bb::unit_type T >
+bb::tape_lease< T >::tape_lease(tape_pool< T > & pool, std::size_t index):
+  __pool(std::addressof(pool)),
+  __index(index)
+{}
+
+template< bb::unit_type T >
+bb::tape_lease< T >::tape_lease(tape_lease && rhs) noexcept:
+  __pool(rhs.__pool),
+  __index(rhs.__index)
+{
+  rhs.__pool = nullptr;
+}
+
+template< bb::unit_type T >
+bb::tape_lease< T > &
+bb::tape_lease< T >::operator=(tape_lease && rhs) noexcept
+{
+  if (this != std::addressof(rhs))
+  {
+    release();
+    __pool = rhs.__pool;
+    __index = rhs.__index;
+    rhs.__pool = nullptr;
+  }
+
+  return *this;
+}
+
+template< bb::unit_type T >
+bb::tape_lease< T >::~tape_lease()
+{
+  release();
+}
+
+template< bb::unit_type T >
+const bb::shared_tape_handler< T > &
+bb::tape_lease< T >::get() const
+{
+  if (!__pool)
+  {
+    throw std::runtime_error("tape_lease: lease is released!");
+  }
+
+  return __pool->__ths[__index];
+}
+
+template< bb::unit_type T >
+bb::tape_handler< T > *
+bb::tape_lease< T >::operator->() const
+{
+  return get().get();
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::tape_lease< T >::index() const
+{
+  return __index;
+}
+
+template< bb::unit_type T >
+void
+bb::tape_lease< T >::release()
+{
+  if (__pool)
+  {
+    __pool->give_back(__index);
+    __pool = nullptr;
+  }
+}
+
+template< bb::unit_type T >
+bb::tape_pool< T >::tape_pool(shared_tape_handlers_view< T > ths):
+  __mutex(),
+  __free_cv(),
+  __ths(ths.begin(), ths.end()),
+  __busy(ths.size(), 0)
+{
+  for (const auto & th : __ths)
+  {
+    if (!th)
+    {
+      throw std::runtime_error("tape_pool: tape_handler is null!");
+    }
+  }
+}
+
+template< bb::unit_type T >
+bb::tape_lease< T >
+bb::tape_pool< T >::acquire()
+{
+  if (__ths.empty())
+  {
+    throw std::runtime_error("tape_pool: pool is empty!");
+  }
+
+  std::unique_lock< std::mutex > lock(__mutex);
+  __free_cv.wait(lock, [this]()
+  {
+    return find_free().has_value();
+  });
+
+  return lease(*find_free());
+}
+
+template< bb::unit_type T >
+bb::tape_lease< T >
+bb::tape_pool< T >::acquire(std::size_t index)
+{
+  if (index >= __ths.size())
+  {
+    throw std::runtime_error("tape_pool: bad device index!");
+  }
+
+  std::unique_lock< std::mutex > lock(__mutex);
+  __free_cv.wait(lock, [this, index]()
+  {
+    return !__busy[index];
+  });
+
+  return lease(index);
+}
+
+template< bb::unit_type T >
+std::optional< bb::tape_lease< T > >
+bb::tape_pool< T >::try_acquire_for(std::chrono::milliseconds timeout)
+{
+  std::unique_lock< std::mutex > lock(__mutex);
+  if (!__free_cv.wait_for(lock, timeout, [this]()
+  {
+    return find_free().has_value();
+  }))
+  {
+    return std::nullopt;
+  }
+
+  return lease(*find_free());
+}
+
+template< bb::unit_type T >
+bb::tape_lease< T >
+bb::tape_pool< T >::acquire_at(std::size_t at)
+{
+  if (__ths.empty())
+  {
+    throw std::runtime_error("tape_pool: pool is empty!");
+  }
+
+  std::unique_lock< std::mutex > lock(__mutex);
+  __free_cv.wait(lock, [this]()
+  {
+    return find_free().has_value();
+  });
+
+  return lease(*find_free(), at);
+}
+
+template< bb::unit_type T >
+std::optional< bb::tape_lease< T > >
+bb::tape_pool< T >::try_acquire_at(std::size_t at)
+{
+  std::lock_guard< std::mutex > lock(__mutex);
+  auto index = find_free();
+  if (!index.has_value())
+  {
+    return std::nullopt;
+  }
+
+  return lease(*index, at);
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::tape_pool< T >::size() const
+{
+  return __ths.size();
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::tape_pool< T >::available() const
+{
+  std::lock_guard< std::mutex > lock(__mutex);
+  return std::count(__busy.begin(), __busy.end(), 0);
+}
+
+template< bb::unit_type T >
+std::size_t
+bb::tape_pool< T >::elapsed() const
+{
+  std::size_t time = 0;
+  for (const auto & th : __ths)
+  {
+    time = std::max(time, th->elapsed());
+  }
+
+  return time;
+}
+
+template< bb::unit_type T >
+std::optional< std::size_t >
+bb::tape_pool< T >::find_free() const
+{
+  // the caller holds the lock
+  std::optional< std::size_t > found = std::nullopt;
+  for (std::size_t i = 0; i < __busy.size(); ++i)
+  {
+    if (!__busy[i] && (!found || __ths[i]->elapsed() < __ths[*found]->elapsed()))
+    {
+      found = i;
+    }
+  }
+
+  return found;
+}
+
+template< bb::unit_type T >
+bb::tape_lease< T >
+bb::tape_pool< T >::lease(std::size_t index, std::optional< std::size_t > at)
+{
+  // the caller holds the lock
+  if (at.has_value())
+  {
+    __ths[index]->take(*at);
+  }
+  else
+  {
+    __ths[index]->take();
+  }
+  __busy[index] = 1;
+  return tape_lease< T >(*this, index);
+}
+
+template< bb::unit_type T >
+void
+bb::tape_pool< T >::give_back(std::size_t index)
+{
+  {
+    std::lock_guard< std::mutex > lock(__mutex);
+    __ths[index]->release_tape();
+    __ths[index]->free();
+    __busy[index] = 0;
+  }
+  __free_cv.notify_all();
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <memory>
+#include <span>
 
 #include <bbtape/json.hpp>
 
@@ -32,6 +33,13 @@ namespace bb
 
   template< unit_type T >
   using unique_unit = std::unique_ptr< unit< T > >;
+
+  template< typename W, typename T >
+  concept unit_writer = requires(W & writer, std::span< const T > rhs)
+  {
+    writer.write(rhs);
+    writer.close();
+  };
 }
 
 #endif
@@ -5,6 +5,10 @@
 #include <vector>
 #include <chrono>
 #include <string_view>
+#include <span>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
 
 #include <bbtape/unit.hpp>
 
@@ -17,10 +21,10 @@ namespace bb::utils
   get_path_from_string(std::string_view path);
 
   fs::path
-  create_tmp_file();
+  create_tmp_file(std::string_view extension = ".json");
 
   fs::path
-  atomic_create_tmp_file();
+  atomic_create_tmp_file(std::string_view extension = ".json");
 
   void
   remove_file(const fs::path & path);
@@ -46,6 +50,10 @@ namespace bb::utils
   template< bb::unit_type T >
   bool
   soft_sort_validation(const bb::unit< T > & src);
+
+  template< typename R, bb::unit_type T >
+  bool
+  soft_sort_validation(R & src, std::span< T > buffer);
 }
 
 template< bb::utils::duration_type T >
@@ -63,4 +71,34 @@ bb::utils::soft_sort_validation(const bb::unit< T > & src)
   return std::is_sorted(src.cbegin(), src.cend());
 }
 
+template< typename R, bb::unit_type T >
+bool
+bb::utils::soft_sort_validation(R & src, std::span< T > buffer)
+{
+  if (buffer.empty())
+  {
+    throw std::runtime_error("soft_sort_validation: buffer is empty!");
+  }
+
+  std::optional< T > last;
+  std::size_t was_read = src.read(buffer);
+  while (was_read != 0)
+  {
+    auto chunk = buffer.first(was_read);
+    if (last.has_value() && chunk.front() < *last)
+    {
+      return false;
+    }
+    if (!std::is_sorted(chunk.begin(), chunk.end()))
+    {
+      return false;
+    }
+
+    last = chunk.back();
+    was_read = src.read(buffer);
+  }
+
+  return true;
+}
+
 #endif
@@ -0,0 +1,31 @@
+#ifndef BBTAPE_VIRTUAL_CLOCK_HPP
+#define BBTAPE_VIRTUAL_CLOCK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace bb
+{
+  /*
+    simulated time in milliseconds shared by all devices,
+    a device publishes its own time when a task is done, so
+    now() is the end of all the tasks done so far, a task that
+    waits for all of them starts at now()
+  */
+  class virtual_clock
+  {
+    public:
+      virtual_clock();
+
+      std::size_t now() const;
+      void advance_to(std::size_t time);
+
+    private:
+      std::atomic< std::size_t > __now;
+  };
+
+  using shared_virtual_clock = std::shared_ptr< virtual_clock >;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include <bbtape/json_stream.hpp>
+
+#include <stdexcept>
+
+bb::json_tape_scanner::json_tape_scanner(const fs::path & path):
+  __buf(),
+  __first(true),
+  __done(false)
+{
+  utils::verify_file_path(path);
+
+  if (!__buf.open(path, std::ios::in | std::ios::binary))
+  {
+    throw std::runtime_error("json_tape_scanner: can't open file!");
+  }
+
+  skip_ws();
+  expect('{');
+  skip_ws();
+  if (peek() == '}')
+  {
+    throw std::runtime_error("verify_tape_field: field tape missed!");
+  }
+
+  while (true)
+  {
+    skip_ws();
+    std::string key;
+    copy_string(std::addressof(key));
+    skip_ws();
+    expect(':');
+    skip_ws();
+
+    if (key == "\"tape\"")
+    {
+      if (peek() != '[')
+      {
+        throw std::runtime_error("verify_tape_field: field tape must be array!");
+      }
+      get();
+      return;
+    }
+
+    copy_value(nullptr);
+    skip_ws();
+    if (peek() != ',')
+    {
+      throw std::runtime_error("verify_tape_field: field tape missed!");
+    }
+    get();
+  }
+}
+
+bool
+bb::json_tape_scanner::next(std::string & element)
+{
+  if (__done)
+  {
+    return false;
+  }
+
+  skip_ws();
+  if (peek() == ']')
+  {
+    get();
+    __done = true;
+    __buf.close();
+    return false;
+  }
+
+  if (!__first)
+  {
+    expect(',');
+    skip_ws();
+  }
+  __first = false;
+
+  element.clear();
+  copy_value(std::addressof(element));
+  return true;
+}
+
+bool
+bb::json_tape_scanner::done() const
+{
+  return __done;
+}
+
+int
+bb::json_tape_scanner::peek()
+{
+  return __buf.sgetc();
+}
+
+int
+bb::json_tape_scanner::get()
+{
+  int c = __buf.sbumpc();
+  if (c == std::filebuf::traits_type::eof())
+  {
+    throw std::runtime_error("json_tape_scanner: unexpected end of file!");
+  }
+
+  return c;
+}
+
+void
+bb::json_tape_scanner::expect(char c)
+{
+  if (get() != c)
+  {
+    throw std::runtime_error(std::string("json_tape_scanner: malformed json, expected '") + c + "'!");
+  }
+}
+
+void
+bb::json_tape_scanner::skip_ws()
+{
+  int c = peek();
+  while (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+  {
+    __buf.sbumpc();
+    c = peek();
+  }
+}
+
+void
+bb::json_tape_scanner::copy_string(std::string * dst)
+{
+  if (peek() != '"')
+  {
+    throw std::runtime_error("json_tape_scanner: malformed json, expected string!");
+  }
+
+  bool escaped = false;
+  int c = get();
+  do
+  {
+    if (dst)
+    {
+      dst->push_back(static_cast< char >(c));
+    }
+    c = get();
+    if (escaped)
+    {
+      escaped = false;
+    }
+    else if (c == '\\')
+    {
+      escaped = true;
+    }
+    else if (c == '"')
+    {
+      break;
+    }
+  }
+  while (true);
+
+  if (dst)
+  {
+    dst->push_back('"');
+  }
+}
+
+void
+bb::json_tape_scanner::copy_value(std::string * dst)
+{
+  int c = peek();
+  if (c == '"')
+  {
+    copy_string(dst);
+    return;
+  }
+
+  if (c == '{' || c == '[')
+  {
+    std::size_t depth = 0;
+    do
+    {
+      c = peek();
+      if (c == '"')
+      {
+        copy_string(dst);
+        continue;
+      }
+
+      get();
+      if (dst)
+      {
+        dst->push_back(static_cast< char >(c));
+      }
+      if (c == '{' || c == '[')
+      {
+        ++depth;
+      }
+      else if (c == '}' || c == ']')
+      {
+        --depth;
+      }
+    }
+    while (depth != 0);
+    return;
+  }
+
+  std::size_t length = 0;
+  while (c != ',' && c != ']' && c != '}' && c != ' ' && c != '\n' && c != '\r' && c != '\t')
+  {
+    if (c == std::filebuf::traits_type::eof())
+    {
+      throw std::runtime_error("json_tape_scanner: unexpected end of file!");
+    }
+    if (dst)
+    {
+      dst->push_back(static_cast< char >(c));
+    }
+    __buf.sbumpc();
+    c = peek();
+    ++length;
+  }
+
+  if (length == 0)
+  {
+    throw std::runtime_error("json_tape_scanner: malformed json, expected value!");
+  }
+}
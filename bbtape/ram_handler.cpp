@@ -1,5 +1,9 @@
 #include <bbtape/ram_handler.hpp>
 
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
 std::size_t
 bb::balance_ram_block(std::size_t ram_size, std::size_t lhs_size, std::size_t rhs_size)
 {
@@ -32,3 +36,49 @@ bb::balance_ram_block(std::size_t ram_size, std::size_t lhs_size, std::size_t rh
 
   return for_lhs;
 }
+
+std::vector< std::size_t >
+bb::balance_ram_blocks(std::size_t ram_size, std::span< const std::size_t > sizes)
+{
+  std::vector< std::size_t > result(sizes.size(), 0);
+  std::size_t total = std::accumulate(sizes.begin(), sizes.end(), std::size_t(0));
+  if (total == 0)
+  {
+    return result;
+  }
+
+  if (total <= ram_size)
+  {
+    std::copy(sizes.begin(), sizes.end(), result.begin());
+    return result;
+  }
+
+  std::size_t non_empty = std::count_if(sizes.begin(), sizes.end(), [](std::size_t size)
+  {
+    return size != 0;
+  });
+  if (ram_size < non_empty)
+  {
+    throw std::runtime_error("balance_ram_blocks: ram size is too small!");
+  }
+
+  const std::size_t min_size = 1;
+  std::size_t spare = ram_size - non_empty * min_size;
+  std::size_t used = 0;
+  for (std::size_t i = 0; i < sizes.size(); ++i)
+  {
+    if (sizes[i] == 0)
+    {
+      continue;
+    }
+
+    double ratio = static_cast< double >(sizes[i]) / total;
+    result[i] = min_size + static_cast< std::size_t >(spare * ratio);
+    used = used + result[i];
+  }
+
+  auto biggest = std::max_element(sizes.begin(), sizes.end());
+  result[std::distance(sizes.begin(), biggest)] += ram_size - used;
+
+  return result;
+}
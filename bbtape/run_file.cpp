@@ -0,0 +1,266 @@
+#include <bbtape/run_file.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr std::array< char, 4 > run_magic = {'B', 'B', 'R', 'N'};
+
+  template< typename T >
+  void
+  put_field(std::array< char, bb::run_header_size > & dst, std::size_t offset, T value)
+  {
+    std::memcpy(dst.data() + offset, &value, sizeof(T));
+  }
+
+  template< typename T >
+  T
+  get_field(const std::array< char, bb::run_header_size > & src, std::size_t offset)
+  {
+    T value;
+    std::memcpy(&value, src.data() + offset, sizeof(T));
+    return value;
+  }
+}
+
+std::array< char, bb::run_header_size >
+bb::encode_run_header(const run_header & header)
+{
+  std::array< char, run_header_size > raw{};
+  std::memcpy(raw.data(), run_magic.data(), run_magic.size());
+  put_field(raw, 4, header.version);
+  put_field(raw, 6, header.endianness);
+  put_field(raw, 8, header.type_tag);
+  put_field(raw, 12, header.type_size);
+  put_field(raw, 16, header.count);
+
+  return raw;
+}
+
+bb::run_header
+bb::decode_run_header(const std::array< char, run_header_size > & raw)
+{
+  if (std::memcmp(raw.data(), run_magic.data(), run_magic.size()) != 0)
+  {
+    throw std::runtime_error("decode_run_header: bad magic!");
+  }
+
+  run_header header;
+  header.endianness = get_field< std::uint8_t >(raw, 6);
+  if (header.endianness != make_run_header< std::int32_t >(0).endianness)
+  {
+    throw std::runtime_error("decode_run_header: foreign endianness!");
+  }
+
+  header.version = get_field< std::uint16_t >(raw, 4);
+  if (header.version != run_version)
+  {
+    throw std::runtime_error("decode_run_header: unsupported version!");
+  }
+
+  header.type_tag = get_field< std::uint32_t >(raw, 8);
+  header.type_size = get_field< std::uint32_t >(raw, 12);
+  header.count = get_field< std::uint64_t >(raw, 16);
+
+  return header;
+}
+
+void
+bb::verify_run_path(const fs::path & path)
+{
+  if (!fs::exists(path))
+  {
+    throw std::runtime_error("verify_run_path: file does not exist!");
+  }
+  if (path.extension() != run_extension)
+  {
+    throw std::runtime_error("verify_run_path: .bbrun required!");
+  }
+}
+
+bb::raw_file::raw_file():
+  __fd(-1)
+{}
+
+bb::raw_file::raw_file(const fs::path & path, bool writable):
+  __fd(-1)
+{
+  int flags = writable ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+  __fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (__fd < 0)
+  {
+    throw std::runtime_error("raw_file: can't open file!");
+  }
+}
+
+bb::raw_file::raw_file(raw_file && rhs) noexcept:
+  __fd(rhs.__fd)
+{
+  rhs.__fd = -1;
+}
+
+bb::raw_file &
+bb::raw_file::operator=(raw_file && rhs) noexcept
+{
+  if (this != std::addressof(rhs))
+  {
+    close();
+    __fd = rhs.__fd;
+    rhs.__fd = -1;
+  }
+
+  return *this;
+}
+
+bb::raw_file::~raw_file()
+{
+  close();
+}
+
+void
+bb::raw_file::write_at(std::uint64_t offset, std::span< const char > src)
+{
+  std::size_t done = 0;
+  while (done < src.size())
+  {
+    ssize_t put = ::pwrite(__fd, src.data() + done, src.size() - done, static_cast< off_t >(offset + done));
+    if (put < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (put <= 0)
+    {
+      throw std::runtime_error("raw_file: write failed!");
+    }
+    done = done + static_cast< std::size_t >(put);
+  }
+}
+
+bool
+bb::raw_file::is_open() const
+{
+  return __fd >= 0;
+}
+
+void
+bb::raw_file::close()
+{
+  if (__fd >= 0)
+  {
+    ::close(__fd);
+    __fd = -1;
+  }
+}
+
+bb::mapped_file::mapped_file():
+  __data(nullptr),
+  __size(0)
+{}
+
+bb::mapped_file::mapped_file(const fs::path & path):
+  __data(nullptr),
+  __size(0)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    throw std::runtime_error("mapped_file: can't open file!");
+  }
+  struct stat info{};
+  if (::fstat(fd, &info) != 0)
+  {
+    ::close(fd);
+    throw std::runtime_error("mapped_file: can't stat file!");
+  }
+  __size = static_cast< std::size_t >(info.st_size);
+  if (__size == 0)
+  {
+    ::close(fd);
+    return;
+  }
+
+  // the mapping keeps the file, the descriptor is not needed any more
+  void * data = ::mmap(nullptr, __size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+  {
+    throw std::runtime_error("mapped_file: can't map file!");
+  }
+
+  __data = static_cast< char * >(data);
+  ::madvise(__data, __size, MADV_SEQUENTIAL);
+}
+
+bb::mapped_file::mapped_file(mapped_file && rhs) noexcept:
+  __data(rhs.__data),
+  __size(rhs.__size)
+{
+  rhs.__data = nullptr;
+  rhs.__size = 0;
+}
+
+bb::mapped_file &
+bb::mapped_file::operator=(mapped_file && rhs) noexcept
+{
+  if (this != std::addressof(rhs))
+  {
+    unmap();
+    __data = rhs.__data;
+    __size = rhs.__size;
+    rhs.__data = nullptr;
+    rhs.__size = 0;
+  }
+
+  return *this;
+}
+
+bb::mapped_file::~mapped_file()
+{
+  unmap();
+}
+
+std::span< const char >
+bb::mapped_file::bytes() const
+{
+  return std::span< const char >(__data, __data ? __size : 0);
+}
+
+void
+bb::mapped_file::release(std::size_t first, std::size_t last)
+{
+  // only the pages lying wholly inside the range
+  const std::size_t page = page_size();
+  first = (first + page - 1) / page * page;
+  last = std::min(last, __size) / page * page;
+  if (__data && first < last)
+  {
+    ::madvise(__data + first, last - first, MADV_DONTNEED);
+  }
+}
+
+std::size_t
+bb::mapped_file::page_size()
+{
+  static const std::size_t page = static_cast< std::size_t >(::sysconf(_SC_PAGESIZE));
+  return page;
+}
+
+void
+bb::mapped_file::unmap()
+{
+  if (__data)
+  {
+    ::munmap(__data, __size);
+    __data = nullptr;
+    __size = 0;
+  }
+}
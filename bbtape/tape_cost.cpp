@@ -0,0 +1,51 @@
+#include <bbtape/tape_cost.hpp>
+
+bb::tape_cost::tape_cost(const config & rhs):
+  __delay(rhs.m_delay),
+  __model(rhs.m_cost)
+{}
+
+double
+bb::tape_cost::read(std::size_t amount, std::size_t offsets) const
+{
+  if (__model.kind == cost_kind::distance)
+  {
+    return amount * __model.read_per_element;
+  }
+
+  return static_cast< double >(amount * __delay.on_read + offsets * __delay.on_offset);
+}
+
+double
+bb::tape_cost::write(std::size_t amount, std::size_t offsets) const
+{
+  if (__model.kind == cost_kind::distance)
+  {
+    return amount * __model.write_per_element;
+  }
+
+  return static_cast< double >(amount * __delay.on_write + offsets * __delay.on_offset);
+}
+
+double
+bb::tape_cost::roll(std::size_t from, std::size_t to) const
+{
+  if (__model.kind == cost_kind::distance)
+  {
+    std::size_t distance = from < to ? to - from : from - to;
+    return __model.seek_overhead + distance * __model.seek_per_element;
+  }
+
+  return static_cast< double >(__delay.on_roll);
+}
+
+double
+bb::tape_cost::offset() const
+{
+  if (__model.kind == cost_kind::distance)
+  {
+    return __model.seek_per_element;
+  }
+
+  return static_cast< double >(__delay.on_offset);
+}
@@ -8,7 +8,7 @@
 #include <mutex>
 
 bb::utils::fs::path
-bb::utils::create_tmp_file()
+bb::utils::create_tmp_file(std::string_view extension)
 {
   fs::path tmp_path = fs::temp_directory_path();
   fs::path full_path;
@@ -16,7 +16,7 @@ bb::utils::create_tmp_file()
   auto time = std::chrono::system_clock::now().time_since_epoch().count();
   do
   {
-    fs::path filename = std::format("bbtape_{}_{}.json", time, count++);
+    fs::path filename = std::format("bbtape_{}_{}{}", time, count++, extension);
     full_path = tmp_path / filename;
   }
   while (fs::exists(full_path));
@@ -32,11 +32,11 @@ bb::utils::create_tmp_file()
 }
 
 bb::utils::fs::path
-bb::utils::atomic_create_tmp_file()
+bb::utils::atomic_create_tmp_file(std::string_view extension)
 {
   static std::mutex mutex;
   std::lock_guard< std::mutex > lock(mutex);
-  return create_tmp_file();
+  return create_tmp_file(extension);
 }
 
 void
@@ -0,0 +1,19 @@
+#include <bbtape/virtual_clock.hpp>
+
+bb::virtual_clock::virtual_clock():
+  __now(0)
+{}
+
+std::size_t
+bb::virtual_clock::now() const
+{
+  return __now.load();
+}
+
+void
+bb::virtual_clock::advance_to(std::size_t time)
+{
+  std::size_t current = __now.load();
+  while (current < time && !__now.compare_exchange_weak(current, time))
+  {}
+}
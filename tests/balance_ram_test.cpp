@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <bbtape/ram_handler.hpp>
+#include <vector>
 
 TEST(balance_ram_test, zero_lhs_size)
 {
@@ -32,3 +33,31 @@ TEST(balance_ram_test, max_size_constraint)
 {
   EXPECT_EQ(bb::balance_ram_block(10, 100, 1), 9);
 }
+
+TEST(balance_ram_test, blocks_fit_in_ram)
+{
+  std::vector< std::size_t > sizes = {10, 0, 20};
+  EXPECT_EQ(bb::balance_ram_blocks(100, sizes), std::vector< std::size_t >({10, 0, 20}));
+}
+
+TEST(balance_ram_test, blocks_exceed_ram)
+{
+  std::vector< std::size_t > sizes = {70, 30};
+  EXPECT_EQ(bb::balance_ram_blocks(100, sizes), std::vector< std::size_t >({70, 30}));
+
+  std::vector< std::size_t > many = {500, 100, 400, 0};
+  auto parts = bb::balance_ram_blocks(10, many);
+  EXPECT_EQ(parts[0] + parts[1] + parts[2] + parts[3], 10);
+  EXPECT_EQ(parts[3], 0);
+  EXPECT_GE(parts[1], 1);
+  EXPECT_GT(parts[0], parts[2]);
+}
+
+TEST(balance_ram_test, blocks_min_size_constraint)
+{
+  std::vector< std::size_t > sizes = {1000, 1, 1};
+  auto parts = bb::balance_ram_blocks(4, sizes);
+  EXPECT_EQ(parts, std::vector< std::size_t >({2, 1, 1}));
+
+  EXPECT_THROW(bb::balance_ram_blocks(2, sizes), std::runtime_error);
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <bbtape/executor.hpp>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+TEST(executor_test, runs_tasks)
+{
+  bb::executor exec(2);
+  EXPECT_EQ(exec.size(), 2);
+
+  auto value = exec.submit([]()
+  {
+    return 42;
+  });
+  std::atomic< int > calls = 0;
+  auto done = exec.submit([&calls]()
+  {
+    ++calls;
+  });
+
+  EXPECT_EQ(value.get(), 42);
+  done.get();
+  EXPECT_EQ(calls.load(), 1);
+}
+
+TEST(executor_test, workers_are_reused)
+{
+  bb::executor exec(3);
+  std::mutex mutex;
+  std::set< std::thread::id > ids;
+
+  std::vector< std::future< void > > tasks;
+  for (int i = 0; i < 100; ++i)
+  {
+    tasks.push_back(exec.submit([&mutex, &ids]()
+    {
+      std::lock_guard< std::mutex > lock(mutex);
+      ids.insert(std::this_thread::get_id());
+    }));
+  }
+  for (auto & task : tasks)
+  {
+    task.get();
+  }
+
+  EXPECT_LE(ids.size(), 3);
+  EXPECT_EQ(ids.count(std::this_thread::get_id()), 0);
+}
+
+TEST(executor_test, move_only_task)
+{
+  bb::executor exec(1);
+  auto value = std::make_unique< int >(7);
+  auto result = exec.submit([value = std::move(value)]() mutable
+  {
+    return *value;
+  });
+
+  EXPECT_EQ(result.get(), 7);
+}
+
+TEST(executor_test, exception_reaches_future)
+{
+  bb::executor exec(1);
+  auto result = exec.submit([]() -> int
+  {
+    throw std::runtime_error("task failed!");
+  });
+
+  EXPECT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(executor_test, cancelled_task)
+{
+  bb::executor exec(1);
+  std::promise< void > gate;
+  auto blocker = exec.submit([opened = gate.get_future().share()]()
+  {
+    opened.wait();
+  });
+
+  // the only worker is busy, so the second task is still queued when stopped
+  std::stop_source stop;
+  std::atomic< bool > ran = false;
+  auto cancelled = exec.submit([&ran]()
+  {
+    ran = true;
+  }, stop.get_token());
+  stop.request_stop();
+  gate.set_value();
+
+  blocker.get();
+  EXPECT_THROW(cancelled.get(), std::runtime_error);
+  EXPECT_FALSE(ran.load());
+}
+
+TEST(executor_test, destructor_cancels_queued_tasks)
+{
+  std::future< void > queued;
+  std::promise< void > gate;
+  std::atomic< bool > ran = false;
+  std::thread opener;
+  {
+    bb::executor exec(1);
+    exec.submit([opened = gate.get_future().share()]()
+    {
+      opened.wait();
+    });
+    queued = exec.submit([&ran]()
+    {
+      ran = true;
+    });
+
+    opener = std::thread([&gate]()
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      gate.set_value();
+    });
+  }
+  opener.join();
+
+  EXPECT_THROW(queued.get(), std::runtime_error);
+  EXPECT_FALSE(ran.load());
+}
+
+TEST(executor_test, zero_workers)
+{
+  EXPECT_THROW(bb::executor(0), std::runtime_error);
+}
+
+TEST(executor_test, pinned_workers)
+{
+  bb::executor exec(2, true);
+  EXPECT_EQ(exec.submit([]()
+  {
+    return 1;
+  }).get(), 1);
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <bbtape/json_stream.hpp>
+#include <bbtape/tape_handler.hpp>
+#include <bbtape/utils.hpp>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+  bb::fs::path
+  make_json_file(std::string_view content)
+  {
+    auto path = bb::utils::create_tmp_file();
+    std::ofstream out(path);
+    out << content;
+    return path;
+  }
+}
+
+TEST(json_stream_test, read_by_chunks) 
+{
+  auto path = make_json_file(R"({"tape": [3, -2, 7, 1, 0]})");
+  bb::json_tape_reader< int32_t > in(path);
+
+  std::vector< int32_t > chunk(2);
+  EXPECT_EQ(in.read(chunk), 2);
+  EXPECT_EQ(chunk, std::vector< int32_t >({3, -2}));
+  EXPECT_EQ(in.read(chunk), 2);
+  EXPECT_EQ(chunk, std::vector< int32_t >({7, 1}));
+  EXPECT_EQ(in.read(chunk), 1);
+  EXPECT_EQ(chunk[0], 0);
+  EXPECT_TRUE(in.done());
+  EXPECT_EQ(in.read(chunk), 0);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(json_stream_test, skip_other_fields) 
+{
+  auto path = make_json_file(R"({
+    "delay": {"on_read": 1, "nested": [1, {"a": "]}"}]},
+    "name": "tape\"[",
+    "tape": [ 1 ,
+      2,3 ],
+    "physical_limit": {"ram": 4096, "conv": 1}
+  })");
+  bb::json_tape_reader< int32_t > in(path);
+
+  std::vector< int32_t > chunk(10);
+  EXPECT_EQ(in.read(chunk), 3);
+  EXPECT_EQ(chunk[0], 1);
+  EXPECT_EQ(chunk[2], 3);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(json_stream_test, empty_tape) 
+{
+  auto path = make_json_file(R"({"tape": []})");
+  bb::json_tape_reader< int32_t > in(path);
+
+  std::vector< int32_t > chunk(4);
+  EXPECT_EQ(in.read(chunk), 0);
+  EXPECT_TRUE(in.done());
+
+  bb::utils::remove_file(path);
+}
+
+TEST(json_stream_test, non_integer_values) 
+{
+  auto path = make_json_file(R"({"tape": [1.5, -2e1]})");
+  bb::json_tape_reader< double > in(path);
+
+  std::vector< double > chunk(2);
+  EXPECT_EQ(in.read(chunk), 2);
+  EXPECT_DOUBLE_EQ(chunk[0], 1.5);
+  EXPECT_DOUBLE_EQ(chunk[1], -20.0);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(json_stream_test, bad_tape_field) 
+{
+  auto missed = make_json_file(R"({"delay": {}})");
+  auto not_array = make_json_file(R"({"tape": 5})");
+  auto broken = make_json_file(R"({"tape": [1, 2)");
+
+  EXPECT_THROW(bb::json_tape_reader< int32_t >{missed}, std::runtime_error);
+  EXPECT_THROW(bb::json_tape_reader< int32_t >{not_array}, std::runtime_error);
+
+  bb::json_tape_reader< int32_t > in(broken);
+  std::vector< int32_t > chunk(4);
+  EXPECT_THROW(in.read(chunk), std::runtime_error);
+
+  bb::utils::remove_file(missed);
+  bb::utils::remove_file(not_array);
+  bb::utils::remove_file(broken);
+}
+
+TEST(json_stream_test, writer_round_trip) 
+{
+  auto path = bb::utils::create_tmp_file();
+  {
+    bb::json_tape_writer< int32_t > out(path);
+    std::vector< int32_t > chunk = {-5, 0, 7};
+    out.write(chunk);
+    out.write(12);
+    EXPECT_EQ(out.size(), 4);
+  }
+
+  EXPECT_EQ(bb::read_tape_from_file< int32_t >(path), std::vector< int32_t >({-5, 0, 7, 12}));
+
+  bb::json_tape_reader< int32_t > in(path);
+  std::vector< int32_t > chunk(10);
+  EXPECT_EQ(in.read(chunk), 4);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(json_stream_test, writer_empty_tape) 
+{
+  auto path = bb::utils::create_tmp_file();
+  bb::json_tape_writer< int32_t > out(path);
+  out.close();
+
+  EXPECT_TRUE(bb::read_tape_from_file< int32_t >(path).empty());
+
+  bb::utils::remove_file(path);
+}
+
+TEST(json_stream_test, writer_rooms) 
+{
+  auto path = bb::utils::create_tmp_file();
+  std::vector< int32_t > lhs = {-100, -7, 0};
+  std::vector< int32_t > rhs = {5, 42, 1000000};
+  auto text_size = [](const std::vector< int32_t > & values)
+  {
+    std::uint64_t size = 0;
+    for (auto value : values)
+    {
+      size = size + bb::json_text_size(value);
+    }
+    return size;
+  };
+
+  {
+    bb::json_tape_writer< int32_t > out(path);
+    auto first = out.reserve(lhs.size(), text_size(lhs));
+    auto second = out.reserve(rhs.size(), text_size(rhs));
+    out.write(7);
+    EXPECT_EQ(out.size(), 7);
+    EXPECT_TRUE(first.first);
+    EXPECT_FALSE(second.first);
+
+    // the rooms are filled in any order
+    bb::json_tape_part< int32_t > second_part(second);
+    second_part.write(rhs);
+    second_part.close();
+    bb::json_tape_part< int32_t > first_part(first);
+    first_part.write(lhs);
+    first_part.close();
+  }
+  EXPECT_EQ(bb::read_tape_from_file< int32_t >(path), std::vector< int32_t >({-100, -7, 0, 5, 42, 1000000, 7}));
+
+  // a room takes exactly the values it was reserved for
+  {
+    bb::json_tape_writer< int32_t > out(path);
+    auto room = out.reserve(lhs.size(), text_size(lhs));
+    bb::json_tape_part< int32_t > part(room);
+    part.write(-7);
+    EXPECT_THROW(part.write(lhs), std::runtime_error);
+    EXPECT_THROW(part.close(), std::runtime_error);
+  }
+
+  bb::utils::remove_file(path);
+}
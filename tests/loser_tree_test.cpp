@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <bbtape/loser_tree.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+  std::vector< int32_t >
+  merge_with_tree(const std::vector< std::vector< int32_t > > & src)
+  {
+    bb::loser_tree< int32_t > tree(src.size());
+    std::vector< std::size_t > pos(src.size(), 0);
+    for (std::size_t i = 0; i < src.size(); ++i)
+    {
+      if (!src[i].empty())
+      {
+        tree.set(i, src[i][0]);
+      }
+    }
+    tree.build();
+
+    std::vector< int32_t > dst;
+    while (!tree.empty())
+    {
+      std::size_t i = tree.top();
+      dst.push_back(src[i][pos[i]++]);
+      if (pos[i] < src[i].size())
+      {
+        tree.replace(src[i][pos[i]]);
+      }
+      else
+      {
+        tree.pop();
+      }
+    }
+
+    return dst;
+  }
+}
+
+TEST(loser_tree_test, empty_tree) 
+{
+  bb::loser_tree< int32_t > tree(0);
+  tree.build();
+
+  EXPECT_TRUE(tree.empty());
+  EXPECT_THROW(tree.top(), std::runtime_error);
+}
+
+TEST(loser_tree_test, single_source) 
+{
+  EXPECT_EQ(merge_with_tree({{1, 2, 3}}), std::vector< int32_t >({1, 2, 3}));
+}
+
+TEST(loser_tree_test, two_sources) 
+{
+  EXPECT_EQ(merge_with_tree({{1, 4, 9}, {2, 3, 10, 11}}), std::vector< int32_t >({1, 2, 3, 4, 9, 10, 11}));
+}
+
+TEST(loser_tree_test, max_first) 
+{
+  bb::loser_tree< int32_t, std::greater< int32_t > > tree(3);
+  tree.set(0, 4);
+  tree.set(1, 9);
+  tree.set(2, 7);
+  tree.build();
+
+  EXPECT_EQ(tree.top(), 1);
+  tree.replace(1);
+  EXPECT_EQ(tree.top(), 2);
+  EXPECT_EQ(tree.top_key(), 7);
+}
+
+TEST(loser_tree_test, exhausted_sources) 
+{
+  EXPECT_EQ(merge_with_tree({{}, {5}, {}, {1, 7}, {}}), std::vector< int32_t >({1, 5, 7}));
+}
+
+TEST(loser_tree_test, equal_keys_prefer_lower_source) 
+{
+  bb::loser_tree< int32_t > tree(3);
+  tree.set(0, 5);
+  tree.set(1, 5);
+  tree.set(2, 5);
+  tree.build();
+
+  EXPECT_EQ(tree.top(), 0);
+  tree.pop();
+  EXPECT_EQ(tree.top(), 1);
+  tree.replace(6);
+  EXPECT_EQ(tree.top(), 2);
+  EXPECT_EQ(tree.top_key(), 5);
+}
+
+TEST(loser_tree_test, random_sources) 
+{
+  std::mt19937 gen(42);
+  for (std::size_t k = 1; k <= 17; ++k)
+  {
+    std::vector< std::vector< int32_t > > src(k);
+    std::vector< int32_t > expected;
+    for (auto & run : src)
+    {
+      run.resize(gen() % 50);
+      for (auto & value : run)
+      {
+        value = static_cast< int32_t >(gen() % 100);
+      }
+      std::sort(run.begin(), run.end());
+      expected.insert(expected.end(), run.begin(), run.end());
+    }
+    std::sort(expected.begin(), expected.end());
+
+    EXPECT_EQ(merge_with_tree(src), expected);
+  }
+}
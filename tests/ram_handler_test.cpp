@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 #include <bbtape/ram_handler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <vector>
 
 TEST(ram_handler_test, init) 
@@ -61,3 +64,102 @@ TEST(ram_handler_test, pick_ram)
   EXPECT_NE(ram, nullptr);
   EXPECT_THROW(rhandler.take_ram_block(), std::runtime_error);
 }
+
+TEST(ram_handler_test, variable_size_blocks) 
+{
+  auto ram = std::make_unique< std::vector< int32_t > >(80);
+  bb::ram_handler rhandler(std::move(ram), 10);
+  EXPECT_EQ(rhandler.max_block_size(), 80);
+
+  // sizes round up to block_size << k
+  auto big = rhandler.take_ram_block(35);
+  EXPECT_EQ(big.size(), 40);
+  auto small = rhandler.take_ram_block();
+  EXPECT_EQ(small.size(), 10);
+  auto middle = rhandler.take_ram_block(20);
+  EXPECT_EQ(middle.size(), 20);
+  EXPECT_THROW(rhandler.take_ram_block(20), std::runtime_error);
+  EXPECT_THROW(rhandler.take_ram_block(100), std::runtime_error);
+
+  // freed buddies join back into the whole ram
+  rhandler.free_ram_block(small);
+  rhandler.free_ram_block(middle);
+  rhandler.free_ram_block(big);
+  auto whole = rhandler.take_ram_block(80);
+  EXPECT_EQ(whole.size(), 80);
+
+  EXPECT_THROW(rhandler.free_ram_block(whole.subspan(5, 10)), std::runtime_error);
+  EXPECT_THROW(rhandler.free_ram_block(whole.subspan(0, 30)), std::runtime_error);
+  rhandler.free_ram_block(whole);
+}
+
+TEST(ram_handler_test, uneven_ram) 
+{
+  // 7 blocks are cut as 4 + 2 + 1
+  auto ram = std::make_unique< std::vector< int32_t > >(75);
+  bb::ram_handler rhandler(std::move(ram), 10);
+  EXPECT_EQ(rhandler.max_block_size(), 40);
+
+  std::vector< bb::ram_view< int32_t > > blocks;
+  for (std::size_t i = 0; i < 7; ++i)
+  {
+    blocks.push_back(rhandler.take_ram_block());
+  }
+  EXPECT_THROW(rhandler.take_ram_block(), std::runtime_error);
+
+  for (auto block : blocks)
+  {
+    rhandler.free_ram_block(block);
+  }
+  EXPECT_EQ(rhandler.take_ram_block(40).size(), 40);
+  EXPECT_EQ(rhandler.take_ram_block(20).size(), 20);
+  EXPECT_THROW(rhandler.take_ram_block(20), std::runtime_error);
+}
+
+TEST(ram_handler_test, wait_for_block) 
+{
+  auto ram = std::make_unique< std::vector< int32_t > >(20);
+  bb::ram_handler rhandler(std::move(ram), 10);
+
+  auto lhs = rhandler.take_ram_block();
+  auto rhs = rhandler.take_ram_block();
+  auto waiter = std::async(std::launch::async, [&rhandler]()
+  {
+    return rhandler.wait_ram_block(20).size();
+  });
+  EXPECT_EQ(waiter.wait_for(std::chrono::milliseconds(20)), std::future_status::timeout);
+
+  rhandler.free_ram_block(lhs);
+  rhandler.free_ram_block(rhs);
+  EXPECT_EQ(waiter.get(), 20);
+}
+
+TEST(ram_handler_test, concurrent_take_and_free) 
+{
+  auto ram = std::make_unique< std::vector< int32_t > >(64);
+  bb::ram_handler rhandler(std::move(ram), 1);
+
+  std::vector< std::future< void > > workers;
+  for (std::size_t t = 0; t < 4; ++t)
+  {
+    workers.push_back(std::async(std::launch::async, [&rhandler, t]()
+    {
+      for (std::size_t i = 0; i < 2000; ++i)
+      {
+        auto block = rhandler.wait_ram_block(1 + (i + t) % 8);
+        std::fill(block.begin(), block.end(), static_cast< int32_t >(t));
+        EXPECT_TRUE(std::all_of(block.begin(), block.end(), [t](int32_t value)
+        {
+          return value == static_cast< int32_t >(t);
+        }));
+        rhandler.free_ram_block(block);
+      }
+    }));
+  }
+  for (auto & worker : workers)
+  {
+    worker.get();
+  }
+
+  EXPECT_EQ(rhandler.take_ram_block(64).size(), 64);
+}
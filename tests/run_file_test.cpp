@@ -0,0 +1,248 @@
+#include <gtest/gtest.h>
+#include <bbtape/run_file.hpp>
+#include <bbtape/utils.hpp>
+#include <algorithm>
+#include <fstream>
+#include <span>
+#include <vector>
+
+TEST(run_file_test, write_and_read) 
+{
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  bb::unit< int32_t > data = {5, -1, 3, 42, 0};
+  bb::write_run_to_file< int32_t >(path, data);
+
+  EXPECT_EQ(bb::fs::file_size(path), bb::run_header_size + data.size() * sizeof(int32_t));
+  EXPECT_EQ(bb::read_run_from_file< int32_t >(path), data);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, empty_run) 
+{
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  bb::write_run_to_file< int32_t >(path, {});
+
+  EXPECT_TRUE(bb::read_run_from_file< int32_t >(path).empty());
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, streaming_reader) 
+{
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  {
+    bb::run_writer< int32_t > out(path);
+    for (int32_t i = 0; i < 10; ++i)
+    {
+      out.write(i);
+    }
+    EXPECT_EQ(out.size(), 10);
+  }
+
+  bb::run_reader< int32_t > in(path);
+  EXPECT_EQ(in.size(), 10);
+
+  std::vector< int32_t > chunk(4);
+  EXPECT_EQ(in.read(chunk), 4);
+  EXPECT_EQ(chunk[3], 3);
+  EXPECT_EQ(in.read(chunk), 4);
+  EXPECT_EQ(in.read(chunk), 2);
+  EXPECT_EQ(chunk[1], 9);
+  EXPECT_EQ(in.remaining(), 0);
+  EXPECT_EQ(in.read(chunk), 0);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, backward_reader) 
+{
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  bb::write_run_to_file< int32_t >(path, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+
+  bb::run_reader< int32_t > in(path);
+  std::vector< int32_t > chunk(4);
+  EXPECT_EQ(in.read_backward(chunk), 4);
+  EXPECT_EQ(chunk, std::vector< int32_t >({9, 8, 7, 6}));
+  EXPECT_EQ(in.read_backward(chunk), 4);
+  EXPECT_EQ(in.read_backward(chunk), 2);
+  EXPECT_EQ(chunk[0], 1);
+  EXPECT_EQ(chunk[1], 0);
+  EXPECT_EQ(in.remaining(), 0);
+  EXPECT_EQ(in.read_backward(chunk), 0);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, range_reader) 
+{
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  bb::write_run_to_file< int32_t >(path, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+
+  bb::run_reader< int32_t > in(path, 3, 5);
+  EXPECT_EQ(in.size(), 5);
+  EXPECT_EQ(in.at(4), 7);
+  std::vector< int32_t > chunk(4);
+  EXPECT_EQ(in.read(chunk), 4);
+  EXPECT_EQ(chunk, std::vector< int32_t >({3, 4, 5, 6}));
+  EXPECT_EQ(in.at(0), 3);
+  EXPECT_EQ(in.read(chunk), 1);
+  EXPECT_EQ(chunk[0], 7);
+
+  bb::run_reader< int32_t > back(path, 3, 5);
+  EXPECT_EQ(back.read_backward(chunk), 4);
+  EXPECT_EQ(chunk, std::vector< int32_t >({7, 6, 5, 4}));
+
+  EXPECT_THROW(bb::run_reader< int32_t >(path, 8, 3), std::runtime_error);
+  EXPECT_THROW(in.at(5), std::runtime_error);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, window_edges) 
+{
+  // small and large blocks around the io window, mixed with probes
+  const std::size_t window = bb::run_window_bytes / sizeof(int32_t);
+  const std::size_t total = 5 * window + 123;
+  std::vector< int32_t > data(total);
+  for (std::size_t i = 0; i < total; ++i)
+  {
+    data[i] = static_cast< int32_t >(i);
+  }
+
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  {
+    bb::run_writer< int32_t > out(path);
+    std::span< const int32_t > rest(data);
+    for (std::size_t step : {std::size_t(7), window - 3, 2 * window, std::size_t(1)})
+    {
+      out.write(rest.first(step));
+      rest = rest.subspan(step);
+    }
+    out.write(rest);
+    out.close();
+  }
+  EXPECT_EQ(bb::read_run_from_file< int32_t >(path), data);
+
+  bb::run_reader< int32_t > in(path);
+  std::vector< int32_t > got;
+  std::vector< int32_t > chunk(window + 5);
+  for (std::size_t step : {std::size_t(5), window - 1, window + 5, std::size_t(3)})
+  {
+    std::size_t read = in.read(std::span< int32_t >(chunk).first(step));
+    got.insert(got.end(), chunk.begin(), chunk.begin() + read);
+    EXPECT_EQ(in.at(total - 1), data[total - 1]);
+  }
+  while (std::size_t read = in.read(chunk))
+  {
+    got.insert(got.end(), chunk.begin(), chunk.begin() + read);
+  }
+  EXPECT_EQ(got, data);
+
+  bb::run_reader< int32_t > back(path);
+  got.clear();
+  for (std::size_t step : {std::size_t(3), window + 5, window - 1})
+  {
+    std::size_t read = back.read_backward(std::span< int32_t >(chunk).first(step));
+    got.insert(got.end(), chunk.begin(), chunk.begin() + read);
+    EXPECT_EQ(back.at(0), 0);
+  }
+  while (std::size_t read = back.read_backward(chunk))
+  {
+    got.insert(got.end(), chunk.begin(), chunk.begin() + read);
+  }
+  std::reverse(got.begin(), got.end());
+  EXPECT_EQ(got, data);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, consumed_pages_are_dropped) 
+{
+  // a few megabytes, so the readers give back their consumed pages on the way
+  const std::size_t total = 3 * bb::run_drop_bytes / sizeof(int32_t) + 17;
+  bb::unit< int32_t > data(total);
+  for (std::size_t i = 0; i < total; ++i)
+  {
+    data[i] = static_cast< int32_t >(i * 7);
+  }
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  bb::write_run_to_file< int32_t >(path, data);
+
+  bb::run_reader< int32_t > in(path);
+  bb::run_reader< int32_t > back(path);
+  std::vector< int32_t > chunk(4093);
+  for (std::size_t done = 0; done < total; )
+  {
+    std::size_t read = in.read(chunk);
+    ASSERT_NE(read, 0);
+    EXPECT_TRUE(std::equal(chunk.begin(), chunk.begin() + read, data.begin() + done));
+
+    std::size_t read_back = back.read_backward(chunk);
+    ASSERT_EQ(read_back, read);
+    EXPECT_TRUE(std::equal(chunk.begin(), chunk.begin() + read_back, data.rbegin() + done));
+    done = done + read;
+  }
+
+  // a dropped page is read from the file again
+  EXPECT_EQ(in.at(0), 0);
+  EXPECT_EQ(back.at(total - 1), data[total - 1]);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, type_mismatch) 
+{
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  bb::write_run_to_file< int32_t >(path, {1, 2, 3});
+
+  EXPECT_THROW(bb::read_run_from_file< uint32_t >(path), std::runtime_error);
+  EXPECT_THROW(bb::read_run_from_file< int64_t >(path), std::runtime_error);
+  EXPECT_THROW(bb::read_run_from_file< float >(path), std::runtime_error);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, bad_header) 
+{
+  auto path = bb::utils::create_tmp_file(bb::run_extension);
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "{\"tape\": [1, 2, 3]}";
+  }
+
+  EXPECT_THROW(bb::read_run_from_file< int32_t >(path), std::runtime_error);
+
+  bb::utils::remove_file(path);
+}
+
+TEST(run_file_test, decode_header) 
+{
+  auto header = bb::make_run_header< int32_t >(7);
+  auto decoded = bb::decode_run_header(bb::encode_run_header(header));
+  EXPECT_EQ(decoded.count, 7);
+  EXPECT_EQ(decoded.type_tag, header.type_tag);
+  EXPECT_EQ(decoded.type_size, header.type_size);
+
+  auto bad_version = header;
+  bad_version.version = bb::run_version + 1;
+  EXPECT_THROW(bb::decode_run_header(bb::encode_run_header(bad_version)), std::runtime_error);
+
+  auto bad_endianness = header;
+  bad_endianness.endianness = header.endianness + 1;
+  EXPECT_THROW(bb::decode_run_header(bb::encode_run_header(bad_endianness)), std::runtime_error);
+
+  auto bad_magic = bb::encode_run_header(header);
+  bad_magic[0] = 'X';
+  EXPECT_THROW(bb::decode_run_header(bad_magic), std::runtime_error);
+}
+
+TEST(run_file_test, bad_extension) 
+{
+  auto path = bb::utils::create_tmp_file();
+
+  EXPECT_THROW(bb::write_run_to_file< int32_t >(path, {1}), std::runtime_error);
+  EXPECT_THROW(bb::read_run_from_file< int32_t >(path), std::runtime_error);
+
+  bb::utils::remove_file(path);
+}
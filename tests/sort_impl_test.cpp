@@ -0,0 +1,665 @@
+#include <gtest/gtest.h>
+#include <bbtape/sort_impl.hpp>
+#include "test_utils.hpp"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+  bb::file_handler
+  make_runs(std::size_t amount, std::size_t max_size, std::vector< int32_t > & all)
+  {
+    std::mt19937 gen(amount * 31 + max_size);
+    bb::file_handler runs;
+    for (std::size_t i = 0; i < amount; ++i)
+    {
+      bb::unit< int32_t > run(gen() % (max_size + 1));
+      for (auto & value : run)
+      {
+        value = static_cast< int32_t >(gen() % 1000);
+      }
+      std::sort(run.begin(), run.end());
+      all.insert(all.end(), run.begin(), run.end());
+
+      auto path = bb::utils::create_tmp_file(bb::run_extension);
+      bb::write_run_to_file< int32_t >(path, run);
+      runs.push_back(path);
+    }
+    std::sort(all.begin(), all.end());
+    return runs;
+  }
+}
+
+TEST(sort_impl_test, k_way_merge) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(7, 50, expected);
+  auto ths = make_tape_handlers(1);
+  bb::unit< int32_t > ram(16);
+
+  auto dst = bb::merge< int32_t >(ths[0], runs.view(0, runs.size()), ram);
+  EXPECT_EQ(bb::read_run_from_file< int32_t >(dst), expected);
+
+  bb::utils::remove_file(dst);
+}
+
+TEST(sort_impl_test, merge_grows_into_granted_ram) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(4, 2000, expected);
+
+  std::vector< std::size_t > rolls;
+  for (bool open : {false, true})
+  {
+    auto ths = make_tape_handlers(1);
+    bb::ram_handler< int32_t > rhandler(std::make_unique< std::vector< int32_t > >(256), 8);
+    bb::ram_grant< int32_t > grant(rhandler);
+    auto block = rhandler.take_ram_block(64);
+    if (open)
+    {
+      grant.open();
+    }
+
+    auto dst = bb::merge< int32_t >(ths[0], runs.view(0, runs.size()), block, std::addressof(grant));
+    EXPECT_EQ(bb::read_run_from_file< int32_t >(dst), expected);
+    bb::utils::remove_file(dst);
+    rolls.push_back(ths[0]->roll_count());
+
+    // every grown buffer is back
+    rhandler.free_ram_block(block);
+    EXPECT_EQ(rhandler.take_ram_block(256).size(), 256);
+  }
+
+  // bigger buffers mean fewer refills, so fewer seeks between the runs
+  EXPECT_LT(rolls[1], rolls[0]);
+}
+
+TEST(sort_impl_test, merge_with_an_output_device) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(4, 300, expected);
+  bb::config timed_config = {{1, 1, 0, 0, bb::delay_mode::virtual_time}, {1, 1}};
+  auto th = std::make_shared< bb::tape_handler< int32_t > >(timed_config);
+  auto out_th = std::make_shared< bb::tape_handler< int32_t > >(timed_config);
+  bb::executor exec(2);
+  bb::unit< int32_t > ram(64);
+
+  auto dst = bb::merge< int32_t >(th, runs.view(0, runs.size()), ram, nullptr, std::addressof(exec), out_th);
+  EXPECT_EQ(bb::read_run_from_file< int32_t >(dst), expected);
+  bb::utils::remove_file(dst);
+
+  // the inputs are only read through th, the output is only written through out_th
+  EXPECT_EQ(th->elapsed(), expected.size());
+  EXPECT_EQ(out_th->elapsed(), expected.size());
+}
+
+TEST(sort_impl_test, merge_forecasts_refills) 
+{
+  // the input running out first is read ahead on a spare device, while th writes the output
+  std::vector< int32_t > expected;
+  auto runs = make_runs(3, 3000, expected);
+  bb::config timed_config = {{1, 1, 1, 1, bb::delay_mode::virtual_time}, {1, 1}};
+
+  std::vector< std::size_t > times;
+  for (bool forecast : {false, true})
+  {
+    auto th = std::make_shared< bb::tape_handler< int32_t > >(timed_config);
+    auto ahead_th = std::make_shared< bb::tape_handler< int32_t > >(timed_config);
+    bb::executor exec(2);
+    bb::ram_handler< int32_t > rhandler(std::make_unique< std::vector< int32_t > >(4096), 8);
+    bb::ram_grant< int32_t > grant(rhandler);
+    auto block = rhandler.take_ram_block(2048);
+    grant.open();
+
+    auto dst = bb::merge< int32_t >(th, runs.view(0, runs.size()), block, std::addressof(grant), std::addressof(exec), nullptr, forecast ? ahead_th : nullptr);
+    EXPECT_EQ(bb::read_run_from_file< int32_t >(dst), expected);
+    bb::utils::remove_file(dst);
+
+    // the forecast reads go through the spare device, beside the io of th
+    EXPECT_EQ(ahead_th->elapsed() != 0, forecast);
+    times.push_back(std::max(th->elapsed(), ahead_th->elapsed()));
+
+    // a buffer that changed hands with the spare still gives its grown block back
+    rhandler.free_ram_block(block);
+    EXPECT_EQ(rhandler.take_ram_block(4096).size(), 4096);
+  }
+  EXPECT_LT(times[1] * 3, times[0] * 2);
+}
+
+TEST(sort_impl_test, merge_with_a_head_per_stream) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(5, 400, expected);
+
+  std::vector< std::size_t > rolls;
+  for (std::size_t heads : {1, 6})
+  {
+    bb::config head_config = {{0, 0, 0, 0}, {1, 1, heads}};
+    auto th = std::make_shared< bb::tape_handler< int32_t > >(head_config);
+    bb::unit< int32_t > ram(60);
+
+    auto dst = bb::merge< int32_t >(th, runs.view(0, runs.size()), ram);
+    EXPECT_EQ(bb::read_run_from_file< int32_t >(dst), expected);
+    bb::utils::remove_file(dst);
+    rolls.push_back(th->roll_count());
+  }
+
+  // one head jumps between the streams on every refill, with a head each
+  // every stream rolls only to its start
+  EXPECT_GT(rolls[0], 6);
+  EXPECT_LE(rolls[1], 6);
+}
+
+TEST(sort_impl_test, merge_ram_too_small) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(4, 10, expected);
+  auto ths = make_tape_handlers(1);
+  bb::unit< int32_t > ram(4);
+
+  EXPECT_THROW(bb::merge< int32_t >(ths[0], runs.view(0, runs.size()), ram), std::runtime_error);
+}
+
+TEST(sort_impl_test, co_rank) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(5, 60, expected);
+  auto view = runs.view(0, runs.size());
+  std::vector< bb::unit< int32_t > > values;
+  for (const auto & path : view)
+  {
+    values.push_back(bb::read_run_from_file< int32_t >(path));
+  }
+
+  for (std::size_t rank = 0; rank <= expected.size(); ++rank)
+  {
+    auto split = bb::co_rank< int32_t >(view, rank);
+    std::vector< int32_t > before;
+    for (std::size_t j = 0; j < values.size(); ++j)
+    {
+      before.insert(before.end(), values[j].begin(), values[j].begin() + split[j]);
+    }
+    std::sort(before.begin(), before.end());
+    ASSERT_EQ(before, std::vector< int32_t >(expected.begin(), expected.begin() + rank));
+  }
+
+  EXPECT_THROW(bb::co_rank< int32_t >(view, expected.size() + 1), std::runtime_error);
+}
+
+TEST(sort_impl_test, merge_parallel) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(6, 80, expected);
+  auto ths = make_tape_handlers(4);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(ths.size());
+  bb::unit< int32_t > ram(64);
+
+  for (std::size_t parts = 1; parts <= 4; ++parts)
+  {
+    auto dst = bb::utils::create_tmp_file();
+    bb::json_tape_writer< int32_t > out(dst);
+    bb::merge_parallel< int32_t >(pool, exec, runs.view(0, runs.size()), ram, parts, out);
+    out.close();
+
+    EXPECT_EQ(bb::read_tape_from_file< int32_t >(dst), expected);
+    EXPECT_EQ(pool.available(), 4);
+    bb::utils::remove_file(dst);
+  }
+
+  bb::unit< int32_t > small_ram(20);
+  auto dst = bb::utils::create_tmp_file();
+  {
+    bb::json_tape_writer< int32_t > out(dst);
+    EXPECT_THROW(bb::merge_parallel< int32_t >(pool, exec, runs.view(0, runs.size()), small_ram, 3, out), std::runtime_error);
+  }
+  bb::utils::remove_file(dst);
+}
+
+TEST(sort_impl_test, merge_parallel_time) 
+{
+  // values of every sign and text size, so the rooms of the parts are sized right
+  std::mt19937 gen(17);
+  std::vector< int32_t > expected;
+  bb::file_handler runs;
+  for (std::size_t i = 0; i < 6; ++i)
+  {
+    bb::unit< int32_t > run(300);
+    for (auto & value : run)
+    {
+      value = static_cast< int32_t >(gen()) >> (gen() % 31);
+    }
+    std::sort(run.begin(), run.end());
+    expected.insert(expected.end(), run.begin(), run.end());
+    auto path = bb::utils::create_tmp_file(bb::run_extension);
+    bb::write_run_to_file< int32_t >(path, run);
+    runs.push_back(path);
+  }
+  std::sort(expected.begin(), expected.end());
+
+  // the parts write their rooms of dst at once, the last pass takes about the time of a part
+  bb::config c = {{1, 1, 1, 1, bb::delay_mode::virtual_time}, {1, 1}};
+  std::vector< std::size_t > times;
+  for (std::size_t parts : {1, 4})
+  {
+    auto clock = std::make_shared< bb::virtual_clock >();
+    bb::shared_tape_handlers< int32_t > ths;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+      ths.push_back(std::make_shared< bb::tape_handler< int32_t > >(c, clock));
+    }
+    bb::tape_pool< int32_t > pool(ths);
+    bb::executor exec(ths.size());
+    bb::unit< int32_t > ram(400);
+
+    auto dst = bb::utils::create_tmp_file();
+    bb::json_tape_writer< int32_t > out(dst);
+    bb::merge_parallel< int32_t >(pool, exec, runs.view(0, runs.size()), ram, parts, out);
+    out.close();
+    EXPECT_EQ(bb::read_tape_from_file< int32_t >(dst), expected);
+    times.push_back(clock->now());
+    bb::utils::remove_file(dst);
+  }
+  EXPECT_LT(times[1] * 3, times[0] * 2);
+}
+
+TEST(sort_impl_test, merge_dag_single_level) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(10, 30, expected);
+  auto ths = make_tape_handlers(3);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(ths.size());
+  auto ram = std::make_unique< std::vector< int32_t > >(60);
+
+  // 10 files -> merges of 4, 3 and 3
+  std::vector< bb::merge_level > levels = {{20, 4}};
+  auto [dst, dst_ram] = bb::merge_dag< int32_t >(std::move(runs), pool, exec, std::move(ram), levels);
+  EXPECT_EQ(dst.size(), 3);
+  EXPECT_EQ(dst_ram->size(), 60);
+  EXPECT_EQ(pool.available(), 3);
+
+  std::vector< int32_t > merged;
+  for (std::size_t i = 0; i < dst.size(); ++i)
+  {
+    auto run = bb::read_run_from_file< int32_t >(dst[i]);
+    EXPECT_TRUE(std::is_sorted(run.begin(), run.end()));
+    merged.insert(merged.end(), run.begin(), run.end());
+  }
+  std::sort(merged.begin(), merged.end());
+  EXPECT_EQ(merged, expected);
+}
+
+TEST(sort_impl_test, merge_dag) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(20, 30, expected);
+  auto ths = make_tape_handlers(3);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(ths.size());
+  auto ram = std::make_unique< std::vector< int32_t > >(80);
+
+  // 20 files -> 5 merges of 4 -> 2 merges of 3 and 2
+  std::vector< bb::merge_level > levels = {{20, 4}, {40, 3}};
+  auto [dst, dst_ram] = bb::merge_dag< int32_t >(std::move(runs), pool, exec, std::move(ram), levels);
+  EXPECT_EQ(dst.size(), 2);
+  EXPECT_EQ(dst_ram->size(), 80);
+  EXPECT_EQ(pool.available(), 3);
+
+  std::vector< int32_t > merged;
+  for (std::size_t i = 0; i < dst.size(); ++i)
+  {
+    auto run = bb::read_run_from_file< int32_t >(dst[i]);
+    EXPECT_TRUE(std::is_sorted(run.begin(), run.end()));
+    merged.insert(merged.end(), run.begin(), run.end());
+  }
+  std::sort(merged.begin(), merged.end());
+  EXPECT_EQ(merged, expected);
+}
+
+TEST(sort_impl_test, merge_dag_rounded_block) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(20, 30, expected);
+  auto ths = make_tape_handlers(3);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(ths.size());
+  auto ram = std::make_unique< std::vector< int32_t > >(120);
+
+  // grain 5: the second level gets 40 of its 60 elements, so buffers of 10 make
+  // it merge 3 files at a time, 20 files -> 5 -> 2 instead of 1
+  std::vector< bb::merge_level > levels = {{20, 4}, {60, 5}};
+  auto [dst, dst_ram] = bb::merge_dag< int32_t >(std::move(runs), pool, exec, std::move(ram), levels);
+  EXPECT_EQ(dst.size(), 2);
+  EXPECT_EQ(pool.available(), 3);
+
+  std::vector< int32_t > merged;
+  for (std::size_t i = 0; i < dst.size(); ++i)
+  {
+    auto run = bb::read_run_from_file< int32_t >(dst[i]);
+    EXPECT_TRUE(std::is_sorted(run.begin(), run.end()));
+    merged.insert(merged.end(), run.begin(), run.end());
+  }
+  std::sort(merged.begin(), merged.end());
+  EXPECT_EQ(merged, expected);
+}
+
+TEST(sort_impl_test, merge_dag_without_levels) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(3, 10, expected);
+  auto first = runs[0];
+  auto ths = make_tape_handlers(1);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(ths.size());
+  auto ram = std::make_unique< std::vector< int32_t > >(20);
+
+  auto [dst, dst_ram] = bb::merge_dag< int32_t >(std::move(runs), pool, exec, std::move(ram), {});
+  EXPECT_EQ(dst.size(), 3);
+  EXPECT_EQ(dst[0], first);
+}
+
+TEST(sort_impl_test, polyphase) 
+{
+  for (std::size_t tapes = 3; tapes <= 6; ++tapes)
+  {
+    for (std::size_t amount : {0, 1, 2, 5, 13, 17})
+    {
+      for (bool read_backward : {false, true})
+      {
+        std::vector< int32_t > expected;
+        auto runs = make_runs(amount, 20, expected);
+        auto ths = make_tape_handlers(tapes);
+        bb::tape_pool< int32_t > pool(ths);
+        bb::executor exec(ths.size());
+        auto ram = std::make_unique< std::vector< int32_t > >(32);
+
+        auto path = bb::utils::create_tmp_file();
+        bb::json_tape_writer< int32_t > dst(path);
+        ram = bb::polyphase< int32_t >(std::move(runs), pool, pool.size(), exec, std::move(ram), dst, read_backward);
+        dst.close();
+
+        EXPECT_NE(ram, nullptr);
+        EXPECT_EQ(bb::read_tape_from_file< int32_t >(path), expected);
+        bb::utils::remove_file(path);
+      }
+    }
+  }
+}
+
+TEST(sort_impl_test, polyphase_single_worker) 
+{
+  // a merge runs io tasks no worker has claimed yet, one worker is enough
+  std::vector< int32_t > expected;
+  auto runs = make_runs(30, 100, expected);
+  auto ths = make_tape_handlers(5);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(1);
+  auto ram = std::make_unique< std::vector< int32_t > >(40);
+
+  auto path = bb::utils::create_tmp_file();
+  bb::json_tape_writer< int32_t > dst(path);
+  ram = bb::polyphase< int32_t >(std::move(runs), pool, pool.size(), exec, std::move(ram), dst);
+  dst.close();
+
+  EXPECT_NE(ram, nullptr);
+  EXPECT_EQ(bb::read_tape_from_file< int32_t >(path), expected);
+  bb::utils::remove_file(path);
+}
+
+TEST(sort_impl_test, polyphase_first_tapes_of_the_pool) 
+{
+  // the phases lease their tapes from the pool of the sort, the devices past them stay untouched
+  std::vector< int32_t > expected;
+  auto runs = make_runs(20, 50, expected);
+  std::sort(expected.begin(), expected.end());
+  auto ths = make_tape_handlers(5);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(ths.size());
+  auto ram = std::make_unique< std::vector< int32_t > >(32);
+
+  auto path = bb::utils::create_tmp_file();
+  bb::json_tape_writer< int32_t > dst(path);
+  ram = bb::polyphase< int32_t >(std::move(runs), pool, 3, exec, std::move(ram), dst);
+  dst.close();
+  EXPECT_EQ(bb::read_tape_from_file< int32_t >(path), expected);
+  bb::utils::remove_file(path);
+
+  EXPECT_EQ(pool.available(), 5);
+  for (std::size_t i = 0; i < ths.size(); ++i)
+  {
+    EXPECT_EQ(ths[i]->roll_count() != 0, i < 3);
+  }
+}
+
+TEST(sort_impl_test, polyphase_read_backward) 
+{
+  // rolls are charged by distance, so a rewind costs as much as the tape is long
+  bb::config timed_config = {{1, 1, 1, 1, bb::delay_mode::virtual_time}, {1, 1}};
+  timed_config.m_cost = {bb::cost_kind::distance, 5, 0.1, 1, 1};
+
+  std::vector< std::size_t > rolls;
+  std::vector< std::size_t > times;
+  for (bool read_backward : {false, true})
+  {
+    // runs of one size, as the run generation gives them
+    std::mt19937 gen(13);
+    std::vector< int32_t > expected;
+    bb::file_handler runs;
+    for (std::size_t i = 0; i < 150; ++i)
+    {
+      bb::unit< int32_t > run(200);
+      for (auto & value : run)
+      {
+        value = static_cast< int32_t >(gen() % 100000);
+      }
+      std::sort(run.begin(), run.end());
+      expected.insert(expected.end(), run.begin(), run.end());
+      auto path = bb::utils::create_tmp_file(bb::run_extension);
+      bb::write_run_to_file< int32_t >(path, run);
+      runs.push_back(path);
+    }
+    std::sort(expected.begin(), expected.end());
+
+    auto clock = std::make_shared< bb::virtual_clock >();
+    bb::shared_tape_handlers< int32_t > ths;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+      ths.push_back(std::make_shared< bb::tape_handler< int32_t > >(timed_config, clock));
+    }
+    bb::tape_pool< int32_t > pool(ths);
+    bb::executor exec(ths.size());
+    auto ram = std::make_unique< std::vector< int32_t > >(64);
+
+    auto path = bb::utils::create_tmp_file();
+    bb::json_tape_writer< int32_t > dst(path);
+    ram = bb::polyphase< int32_t >(std::move(runs), pool, pool.size(), exec, std::move(ram), dst, read_backward);
+    dst.close();
+    EXPECT_EQ(bb::read_tape_from_file< int32_t >(path), expected);
+    bb::utils::remove_file(path);
+
+    std::size_t total = 0;
+    for (const auto & th : ths)
+    {
+      total = total + th->roll_count();
+    }
+    rolls.push_back(total);
+    times.push_back(clock->now());
+  }
+
+  // forward phases rewind every tape they read, backward ones read on from where writing stopped
+  EXPECT_LT(rolls[1], rolls[0]);
+  EXPECT_LT(times[1], times[0]);
+}
+
+TEST(sort_impl_test, polyphase_needs_three_tapes) 
+{
+  std::vector< int32_t > expected;
+  auto runs = make_runs(4, 10, expected);
+  auto ths = make_tape_handlers(2);
+  bb::tape_pool< int32_t > pool(ths);
+  bb::executor exec(ths.size());
+  auto ram = std::make_unique< std::vector< int32_t > >(32);
+
+  auto path = bb::utils::create_tmp_file();
+  bb::json_tape_writer< int32_t > dst(path);
+  EXPECT_THROW(bb::polyphase< int32_t >(std::move(runs), pool, pool.size(), exec, std::move(ram), dst), std::runtime_error);
+  EXPECT_THROW(bb::polyphase< int32_t >(std::move(runs), pool, 3, exec, std::move(ram), dst), std::runtime_error);
+  dst.close();
+  bb::utils::remove_file(path);
+}
+
+TEST(sort_impl_test, replacement_selection) 
+{
+  std::mt19937 gen(7);
+  std::vector< int32_t > random(5000);
+  for (auto & value : random)
+  {
+    value = static_cast< int32_t >(gen() % 100000);
+  }
+  std::vector< int32_t > sorted = random;
+  std::sort(sorted.begin(), sorted.end());
+
+  for (const auto & input : {random, sorted})
+  {
+    auto path = bb::utils::create_tmp_file();
+    bb::write_tape_to_file< int32_t >(path, input);
+    bb::json_tape_reader< int32_t > src(path);
+    auto ths = make_tape_handlers(1);
+    auto ram = std::make_unique< std::vector< int32_t > >(100);
+
+    auto [runs, dst_ram] = bb::replacement_selection< int32_t >(src, ths[0], std::move(ram));
+    EXPECT_NE(dst_ram, nullptr);
+
+    std::vector< int32_t > merged;
+    for (std::size_t i = 0; i < runs.size(); ++i)
+    {
+      auto run = bb::read_run_from_file< int32_t >(runs[i]);
+      EXPECT_TRUE(std::is_sorted(run.begin(), run.end()));
+      merged.insert(merged.end(), run.begin(), run.end());
+    }
+    std::sort(merged.begin(), merged.end());
+    EXPECT_EQ(merged, sorted);
+
+    // the heap takes all but two values of ram, random input gives runs of
+    // about twice the heap, sorted input gives one run
+    if (input == sorted)
+    {
+      EXPECT_EQ(runs.size(), 1);
+    }
+    else
+    {
+      EXPECT_GE(input.size() / runs.size(), 180);
+    }
+    bb::utils::remove_file(path);
+  }
+}
+
+TEST(sort_impl_test, natural_runs) 
+{
+  std::mt19937 gen(11);
+  std::vector< int32_t > sorted(5000);
+  for (std::size_t i = 0; i < sorted.size(); ++i)
+  {
+    sorted[i] = static_cast< int32_t >(i * 3);
+  }
+  std::vector< int32_t > reversed(sorted.rbegin(), sorted.rend());
+  std::vector< int32_t > nearly = sorted;
+  for (std::size_t i = 0; i < 20; ++i)
+  {
+    std::swap(nearly[gen() % nearly.size()], nearly[gen() % nearly.size()]);
+  }
+  std::vector< int32_t > random = sorted;
+  std::shuffle(random.begin(), random.end(), gen);
+
+  // input, max run amount, descending runs are reversed and out of order values
+  // wait in ram, so even reversed input makes runs about as long as the ram
+  std::vector< std::pair< std::vector< int32_t >, std::size_t > > cases = {
+    {sorted, 0},
+    {nearly, 2},
+    {reversed, 5000 / 60},
+    {random, 5000 / 60},
+    {{}, 0}
+  };
+  for (const auto & [input, max_runs] : cases)
+  {
+    auto path = bb::utils::create_tmp_file();
+    auto dst = bb::utils::create_tmp_file();
+    bb::write_tape_to_file< int32_t >(path, input);
+    bb::json_tape_reader< int32_t > src(path);
+    auto ths = make_tape_handlers(1);
+    auto ram = std::make_unique< std::vector< int32_t > >(100);
+
+    auto [runs, dst_ram] = bb::natural_runs< int32_t >(src, ths[0], std::move(ram), dst);
+    EXPECT_NE(dst_ram, nullptr);
+    EXPECT_LE(runs.size(), max_runs);
+
+    std::vector< int32_t > expected = input;
+    std::sort(expected.begin(), expected.end());
+    if (max_runs == 0)
+    {
+      // sorted input is read and written once, straight into dst
+      EXPECT_EQ(runs.size(), 0);
+      EXPECT_EQ(bb::read_tape_from_file< int32_t >(dst), expected);
+    }
+
+    std::vector< int32_t > merged;
+    for (std::size_t i = 0; i < runs.size(); ++i)
+    {
+      auto run = bb::read_run_from_file< int32_t >(runs[i]);
+      EXPECT_TRUE(std::is_sorted(run.begin(), run.end()));
+      merged.insert(merged.end(), run.begin(), run.end());
+    }
+    if (runs.size() != 0)
+    {
+      std::sort(merged.begin(), merged.end());
+      EXPECT_EQ(merged, expected);
+    }
+    bb::utils::remove_file(path);
+    bb::utils::remove_file(dst);
+  }
+}
+
+TEST(sort_impl_test, split_parallel) 
+{
+  std::mt19937 gen(13);
+  std::vector< int32_t > input(20000);
+  for (auto & value : input)
+  {
+    value = static_cast< int32_t >(gen() % 100000);
+  }
+  std::vector< int32_t > expected = input;
+  std::sort(expected.begin(), expected.end());
+
+  for (auto runs : {bb::run_generation::sort, bb::run_generation::replacement_selection})
+  {
+    auto path = bb::utils::create_tmp_file();
+    bb::write_tape_to_file< int32_t >(path, input);
+    bb::json_tape_reader< int32_t > src(path);
+    auto ths = make_tape_handlers(4);
+    bb::tape_pool< int32_t > pool(ths);
+    bb::executor exec(ths.size());
+    auto ram = std::make_unique< std::vector< int32_t > >(400);
+
+    auto [dst, dst_ram] = bb::split_parallel< int32_t >(src, pool, exec, std::move(ram), runs);
+    ASSERT_NE(dst_ram, nullptr);
+    EXPECT_EQ(dst_ram->size(), 400);
+    for (const auto & th : ths)
+    {
+      EXPECT_FALSE(th->is_reserved());
+    }
+
+    std::vector< int32_t > merged;
+    for (std::size_t i = 0; i < dst.size(); ++i)
+    {
+      auto run = bb::read_run_from_file< int32_t >(dst[i]);
+      EXPECT_TRUE(std::is_sorted(run.begin(), run.end()));
+      EXPECT_LE(run.size(), runs == bb::run_generation::sort ? 100 : input.size());
+      merged.insert(merged.end(), run.begin(), run.end());
+    }
+    std::sort(merged.begin(), merged.end());
+    EXPECT_EQ(merged, expected);
+    bb::utils::remove_file(path);
+  }
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <bbtape/sort.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <vector>
+
+namespace
+{
+  // heap bytes in use, counted by the operator new and delete below
+  std::atomic< std::size_t > heap_used = 0;
+  std::atomic< std::size_t > heap_peak = 0;
+
+  void *
+  allocate(std::size_t size)
+  {
+    void * ptr = std::malloc(size == 0 ? 1 : size);
+    if (!ptr)
+    {
+      throw std::bad_alloc();
+    }
+
+    std::size_t used = heap_used.fetch_add(malloc_usable_size(ptr)) + malloc_usable_size(ptr);
+    std::size_t peak = heap_peak.load();
+    while (used > peak && !heap_peak.compare_exchange_weak(peak, used))
+    {}
+    return ptr;
+  }
+
+  void
+  deallocate(void * ptr)
+  {
+    if (ptr)
+    {
+      heap_used.fetch_sub(malloc_usable_size(ptr));
+      std::free(ptr);
+    }
+  }
+}
+
+void * operator new(std::size_t size)
+{
+  return allocate(size);
+}
+
+void * operator new[](std::size_t size)
+{
+  return allocate(size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+  deallocate(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+  deallocate(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+  deallocate(ptr);
+}
+
+void operator delete[](void * ptr, std::size_t) noexcept
+{
+  deallocate(ptr);
+}
+
+TEST(sort_test, ram_limit)
+{
+  std::mt19937 gen(5);
+  std::vector< int32_t > values(300000);
+  for (auto & value : values)
+  {
+    value = static_cast< int32_t >(gen());
+  }
+  auto src = bb::utils::create_tmp_file();
+  auto dst = bb::utils::create_tmp_file();
+  bb::write_tape_to_file< int32_t >(src, values);
+  std::sort(values.begin(), values.end());
+
+  // a device writes one file at a time, which keeps a stream buffer and a window
+  // beside the ram, the rest of the heap the sort takes is within the ram limit
+  const std::size_t ram = 1 << 20;
+  const std::size_t conv = 4;
+  const std::size_t windows = conv * 2 * bb::run_window_bytes;
+  for (auto strategy : {bb::merge_strategy::balanced, bb::merge_strategy::polyphase})
+  {
+    bb::config c = {{0, 0, 0, 0}, {ram, conv}, {strategy, bb::run_generation::sort}};
+    heap_peak = heap_used.load();
+    const std::size_t before = heap_used.load();
+    bb::external_merge_sort< int32_t >(c, src, dst);
+    EXPECT_LE(heap_peak.load() - before, ram + windows);
+    EXPECT_EQ(bb::read_tape_from_file< int32_t >(dst), values);
+  }
+
+  bb::utils::remove_file(src);
+  bb::utils::remove_file(dst);
+}
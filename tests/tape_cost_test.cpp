@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <bbtape/tape_cost.hpp>
+#include <bbtape/tape_handler.hpp>
+
+TEST(tape_cost_test, uniform) 
+{
+  bb::config m_config = {{1, 3, 10, 5}, {1, 1}};
+  bb::tape_cost cost(m_config);
+
+  EXPECT_DOUBLE_EQ(cost.read(4, 3), 4 * 1 + 3 * 5);
+  EXPECT_DOUBLE_EQ(cost.write(4, 4), 4 * 3 + 4 * 5);
+  EXPECT_DOUBLE_EQ(cost.roll(0, 1000), 10);
+  EXPECT_DOUBLE_EQ(cost.roll(1000, 1000), 10);
+  EXPECT_DOUBLE_EQ(cost.offset(), 5);
+}
+
+TEST(tape_cost_test, distance) 
+{
+  bb::config m_config = {{1, 3, 10, 5}, {1, 1}};
+  m_config.m_cost = {bb::cost_kind::distance, 20, 0.5, 0.25, 0.75};
+  bb::tape_cost cost(m_config);
+
+  EXPECT_DOUBLE_EQ(cost.read(4, 3), 1);
+  EXPECT_DOUBLE_EQ(cost.write(4, 4), 3);
+  EXPECT_DOUBLE_EQ(cost.roll(0, 100), 20 + 50);
+  EXPECT_DOUBLE_EQ(cost.roll(100, 0), 20 + 50);
+  EXPECT_DOUBLE_EQ(cost.roll(7, 7), 20);
+  EXPECT_DOUBLE_EQ(cost.offset(), 0.5);
+}
+
+TEST(tape_cost_test, handler_seek_distance) 
+{
+  bb::config m_config = {{0, 0, 0, 0, bb::delay_mode::virtual_time}, {1, 1}};
+  m_config.m_cost = {bb::cost_kind::distance, 10, 1, 0, 0};
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+
+  // a block mounted at logical position 100, the head starts at 0
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(10), 100);
+  thandler.roll(0);
+  EXPECT_EQ(thandler.elapsed(), 10 + 100);
+
+  // streaming over the block moves the head without seek cost
+  std::vector< int32_t > block(10);
+  thandler.read_block(block);
+  EXPECT_EQ(thandler.elapsed(), 110);
+
+  // the head is right behind the block (110), a block at 111 is 1 element away
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(10), 111);
+  thandler.roll(0);
+  EXPECT_EQ(thandler.elapsed(), 110 + 10 + 1);
+}
+
+TEST(tape_cost_test, handler_streams_blocks) 
+{
+  bb::config m_config = {{1, 1, 100, 1, bb::delay_mode::virtual_time}, {1, 1}};
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+  std::vector< int32_t > block(10);
+
+  // a block leaves the head right behind it, the next one goes on without a roll
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(10), 0);
+  thandler.roll(0);
+  thandler.write_block(block);
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(10), 10);
+  thandler.roll(0);
+  thandler.write_block(block);
+  EXPECT_EQ(thandler.elapsed(), 2 * 10 * (1 + 1));
+  EXPECT_EQ(thandler.roll_count(), 0);
+
+  // reading both back from there costs what reading them forward does
+  thandler.roll(10);
+  thandler.read_block_backward(block);
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(10), 0);
+  thandler.roll(10);
+  thandler.read_block_backward(block);
+  EXPECT_EQ(thandler.elapsed(), 40 + 2 * (10 + 9));
+  EXPECT_EQ(thandler.roll_count(), 0);
+
+  // the head stopped on the start of the tape, going forward again is a roll
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(10), 10);
+  thandler.roll(0);
+  EXPECT_EQ(thandler.elapsed(), 78 + 100);
+  EXPECT_EQ(thandler.roll_count(), 1);
+}
@@ -2,6 +2,8 @@
 #include <bbtape/tape_handler.hpp>
 #include <filesystem>
 #include <thread>
+#include <chrono>
+#include <type_traits>
 #include <vector>
 
 TEST(tape_handler_test, init) 
@@ -78,6 +80,125 @@ TEST(tape_handler_test, offset_if_possible)
   EXPECT_EQ(thandler.get_pos(), 1);
 }
 
+TEST(tape_handler_test, read_and_write_block) 
+{
+  bb::config m_config = {{0, 0, 0, 0}, {1, 1}};
+  bb::unit< int32_t > data = {1, 2, 3, 4, 5};
+  auto tape = std::make_unique< bb::unit< int32_t > >(data.begin(), data.end());
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+  thandler.setup_tape(std::move(tape));
+
+  std::vector< int32_t > block(3);
+  EXPECT_EQ(thandler.read_block(block), 3);
+  EXPECT_EQ(block, std::vector< int32_t >({1, 2, 3}));
+  EXPECT_EQ(thandler.get_pos(), 3);
+
+  EXPECT_EQ(thandler.read_block(block), 2);
+  EXPECT_EQ(thandler.get_pos(), 4);
+
+  std::vector< int32_t > values = {10, 20, 30, 40, 50, 60};
+  thandler.roll(0);
+  EXPECT_EQ(thandler.write_block(values), 5);
+  EXPECT_EQ(thandler.get_pos(), 4);
+
+  thandler.roll(0);
+  std::vector< int32_t > all(5);
+  thandler.read_block(all);
+  EXPECT_EQ(all, std::vector< int32_t >({10, 20, 30, 40, 50}));
+}
+
+TEST(tape_handler_test, block_delay) 
+{
+  bb::config m_config = {{2, 0, 0, 1}, {1, 1}};
+  bb::unit< int32_t > data = {1, 2, 3, 4, 5};
+  auto tape = std::make_unique< bb::unit< int32_t > >(data.begin(), data.end());
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+  thandler.setup_tape(std::move(tape));
+
+  // 5 reads and 4 offsets, the head stops on the last value
+  std::vector< int32_t > block(5);
+  auto begin = std::chrono::steady_clock::now();
+  thandler.read_block(block);
+  auto spent = std::chrono::steady_clock::now() - begin;
+  EXPECT_GE(spent, std::chrono::milliseconds(14));
+}
+
+TEST(tape_handler_test, virtual_time) 
+{
+  bb::config m_config = {{1000, 1000, 1000, 1000, bb::delay_mode::virtual_time}, {1, 1}};
+  auto clock = std::make_shared< bb::virtual_clock >();
+  auto lhs = bb::tape_handler< int32_t >(m_config, clock);
+  auto rhs = bb::tape_handler< int32_t >(m_config, clock);
+  std::vector< int32_t > block(5);
+
+  // two devices working at the same time overlap on the clock
+  auto begin = std::chrono::steady_clock::now();
+  lhs.take();
+  rhs.take();
+  lhs.setup_tape(std::make_unique< bb::unit< int32_t > >(5));
+  rhs.setup_tape(std::make_unique< bb::unit< int32_t > >(5));
+  lhs.read_block(block);
+  rhs.roll(2);
+  lhs.release_tape();
+  rhs.release_tape();
+  lhs.free();
+  rhs.free();
+  EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(1000));
+  EXPECT_EQ(lhs.elapsed(), 9000);
+  EXPECT_EQ(rhs.elapsed(), 1000);
+  EXPECT_EQ(clock->now(), 9000);
+
+  // a task started after both is charged from the current clock
+  rhs.take();
+  rhs.setup_tape(std::make_unique< bb::unit< int32_t > >(5));
+  rhs.roll(0);
+  rhs.release_tape();
+  rhs.free();
+  EXPECT_EQ(rhs.elapsed(), 10000);
+  EXPECT_EQ(clock->now(), 10000);
+}
+
+TEST(tape_handler_test, no_delay_single_owner) 
+{
+  // the delays of the config are ignored and the lock does nothing
+  using fast_handler = bb::tape_handler< int32_t, bb::no_delay, bb::single_owner >;
+  static_assert(std::is_empty_v< bb::single_owner::mutex >);
+  bb::config m_config = {{1000, 1000, 1000, 1000}, {1, 1}};
+  bb::unit< int32_t > data = {1, 2, 3, 4, 5};
+  auto thandler = fast_handler(m_config);
+  std::vector< int32_t > block(5);
+
+  auto begin = std::chrono::steady_clock::now();
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(data.begin(), data.end()), 10);
+  thandler.roll(0);
+  thandler.write(10);
+  thandler.offset(1);
+  EXPECT_EQ(thandler.read(), 2);
+  thandler.roll(0);
+  thandler.read_block(block);
+  EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(1000));
+
+  EXPECT_EQ(block, std::vector< int32_t >({10, 2, 3, 4, 5}));
+  EXPECT_EQ(thandler.elapsed(), 0);
+  EXPECT_EQ(thandler.roll_count(), 2);
+  thandler.release_tape();
+}
+
+TEST(tape_handler_test, virtual_delay_policy) 
+{
+  // virtual time whatever the delay mode of the config says
+  bb::config m_config = {{1000, 1000, 1000, 1000}, {1, 1}};
+  auto thandler = bb::tape_handler< int32_t, bb::virtual_delay >(m_config);
+  std::vector< int32_t > block(5);
+
+  auto begin = std::chrono::steady_clock::now();
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5));
+  thandler.read_block(block);
+  EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(1000));
+  EXPECT_EQ(thandler.elapsed(), 9000);
+  thandler.release_tape();
+}
+
 TEST(tape_handler_test, take_and_free) 
 {
   bb::config m_config = {{0, 0, 0, 0}, {1, 1}};
@@ -109,3 +230,102 @@ TEST(tape_handler_test, setup_and_release)
   EXPECT_TRUE(thandler.is_available());
   EXPECT_EQ(tape->size(), 5);
 }
+
+TEST(tape_handler_test, read_block_backward) 
+{
+  bb::config m_config = {{0, 0, 0, 0}, {1, 1}};
+  bb::unit< int32_t > data = {1, 2, 3, 4, 5};
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+  std::vector< int32_t > block(3);
+
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(data.begin(), data.end()));
+  EXPECT_THROW(thandler.read_block_backward(block), std::runtime_error);
+
+  thandler.roll(thandler.size());
+  EXPECT_EQ(thandler.read_block_backward(block), 3);
+  EXPECT_EQ(block, std::vector< int32_t >({5, 4, 3}));
+  EXPECT_EQ(thandler.get_pos(), 2);
+
+  EXPECT_EQ(thandler.read_block_backward(block), 2);
+  EXPECT_EQ(std::vector< int32_t >(block.begin(), block.begin() + 2), std::vector< int32_t >({2, 1}));
+  EXPECT_EQ(thandler.get_pos(), 0);
+  thandler.release_tape();
+}
+
+TEST(tape_handler_test, roll_count) 
+{
+  bb::config m_config = {{0, 0, 0, 0, bb::delay_mode::virtual_time}, {1, 1}};
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+  std::vector< int32_t > block(5);
+
+  // the head starts at 0, so rolling there is free
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5));
+  thandler.roll(0);
+  EXPECT_EQ(thandler.roll_count(), 0);
+
+  // a block read leaves the head right behind it, the next block goes on from there
+  thandler.read_block(block);
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5), 5);
+  thandler.roll(0);
+  EXPECT_EQ(thandler.roll_count(), 0);
+
+  // reading back from the end of that block is free too, rewinding is not
+  thandler.read_block(block);
+  thandler.roll(5);
+  thandler.read_block_backward(block);
+  EXPECT_EQ(thandler.roll_count(), 0);
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5), 0);
+  thandler.roll(0);
+  EXPECT_EQ(thandler.roll_count(), 1);
+  thandler.release_tape();
+}
+
+TEST(tape_handler_test, bad_roll_is_not_charged) 
+{
+  bb::config m_config = {{0, 0, 1000, 0, bb::delay_mode::virtual_time}, {1, 1}};
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+
+  EXPECT_THROW(thandler.roll(3), std::runtime_error);
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5));
+  EXPECT_THROW(thandler.roll(6), std::runtime_error);
+  EXPECT_EQ(thandler.roll_count(), 0);
+  EXPECT_EQ(thandler.elapsed(), 0);
+
+  thandler.roll(5);
+  EXPECT_EQ(thandler.roll_count(), 1);
+  EXPECT_EQ(thandler.elapsed(), 1000);
+  thandler.release_tape();
+}
+
+TEST(tape_handler_test, heads_keep_positions) 
+{
+  bb::config m_config = {{0, 0, 0, 0, bb::delay_mode::virtual_time}, {1, 1, 2}};
+  auto thandler = bb::tape_handler< int32_t >(m_config);
+  std::vector< int32_t > block(5);
+  EXPECT_EQ(thandler.heads(), 2);
+
+  // two streams far apart on the tape, each goes on where its own head stopped
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5), 0, 0);
+  thandler.roll(0);
+  thandler.read_block(block);
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5), 100, 1);
+  thandler.roll(0);
+  thandler.write_block(block);
+  EXPECT_EQ(thandler.roll_count(), 1);
+
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5), 5, 0);
+  thandler.roll(0);
+  thandler.read_block(block);
+  thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5), 105, 1);
+  thandler.roll(0);
+  EXPECT_EQ(thandler.roll_count(), 1);
+
+  EXPECT_THROW(thandler.setup_tape(std::make_unique< bb::unit< int32_t > >(5), 0, 2), std::runtime_error);
+  thandler.release_tape();
+}
+
+TEST(tape_handler_test, zero_heads) 
+{
+  bb::config m_config = {{0, 0, 0, 0}, {1, 1, 0}};
+  EXPECT_THROW(bb::tape_handler< int32_t > thandler(m_config), std::runtime_error);
+}
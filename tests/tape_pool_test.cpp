@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <bbtape/tape_pool.hpp>
+#include "test_utils.hpp"
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+
+namespace
+{
+  // a task of writes on a device that starts at the tape time at
+  void
+  write_task(bb::tape_pool< int32_t > & pool, std::size_t at, std::size_t writes)
+  {
+    auto th = pool.acquire_at(at);
+    th->setup_tape(std::make_unique< bb::unit< int32_t > >(writes));
+    for (std::size_t i = 0; i < writes; ++i)
+    {
+      th->write(1);
+    }
+  }
+}
+
+TEST(tape_pool_test, acquire_and_release) 
+{
+  auto ths = make_tape_handlers(2);
+  bb::tape_pool< int32_t > pool(ths);
+  EXPECT_EQ(pool.size(), 2);
+
+  {
+    auto lhs = pool.acquire();
+    auto rhs = pool.acquire();
+    EXPECT_NE(lhs.index(), rhs.index());
+    EXPECT_TRUE(lhs->is_reserved());
+    EXPECT_TRUE(rhs.get()->is_reserved());
+    EXPECT_EQ(pool.available(), 0);
+
+    // a mounted block does not keep the device from returning
+    lhs->setup_tape(std::make_unique< bb::unit< int32_t > >(3));
+  }
+
+  EXPECT_EQ(pool.available(), 2);
+  EXPECT_FALSE(ths[0]->is_reserved());
+  EXPECT_FALSE(ths[1]->is_reserved());
+  EXPECT_TRUE(ths[0]->is_available());
+}
+
+TEST(tape_pool_test, lease_moves) 
+{
+  auto ths = make_tape_handlers(1);
+  bb::tape_pool< int32_t > pool(ths);
+
+  auto lhs = pool.acquire(0);
+  auto rhs = std::move(lhs);
+  EXPECT_THROW(lhs.get(), std::runtime_error);
+  EXPECT_EQ(pool.available(), 0);
+
+  rhs.release();
+  EXPECT_EQ(pool.available(), 1);
+  EXPECT_THROW(pool.acquire(1), std::runtime_error);
+}
+
+TEST(tape_pool_test, timeout) 
+{
+  auto ths = make_tape_handlers(1);
+  bb::tape_pool< int32_t > pool(ths);
+
+  auto lease = pool.acquire();
+  EXPECT_FALSE(pool.try_acquire_for(std::chrono::milliseconds(10)).has_value());
+
+  lease.release();
+  EXPECT_TRUE(pool.try_acquire_for(std::chrono::milliseconds(10)).has_value());
+}
+
+TEST(tape_pool_test, waiters_wake_up) 
+{
+  auto ths = make_tape_handlers(1);
+  bb::tape_pool< int32_t > pool(ths);
+
+  auto lease = pool.acquire();
+  auto waiter = std::async(std::launch::async, [&pool]()
+  {
+    auto th = pool.acquire(0);
+    return th.index();
+  });
+  EXPECT_EQ(waiter.wait_for(std::chrono::milliseconds(20)), std::future_status::timeout);
+
+  lease.release();
+  EXPECT_EQ(waiter.get(), 0);
+  EXPECT_EQ(pool.available(), 1);
+}
+
+TEST(tape_pool_test, concurrent_tasks) 
+{
+  // two tasks of 3 and 6 writes run at once on two devices, in both modes as long as the longer one
+  bb::config sleep_config = {{0, 20, 0, 0}, {1, 1}};
+  bb::config virtual_config = {{0, 20, 0, 0, bb::delay_mode::virtual_time}, {1, 1}};
+  auto clock = std::make_shared< bb::virtual_clock >();
+  bb::shared_tape_handlers< int32_t > sleep_ths;
+  bb::shared_tape_handlers< int32_t > virtual_ths;
+  for (std::size_t i = 0; i < 2; ++i)
+  {
+    sleep_ths.push_back(std::make_shared< bb::tape_handler< int32_t > >(sleep_config));
+    virtual_ths.push_back(std::make_shared< bb::tape_handler< int32_t > >(virtual_config, clock));
+  }
+  bb::tape_pool< int32_t > sleep_pool(sleep_ths);
+  bb::tape_pool< int32_t > virtual_pool(virtual_ths);
+
+  auto run = [](bb::tape_pool< int32_t > & pool)
+  {
+    const std::size_t at = pool.elapsed();
+    auto lhs = std::async(std::launch::async, [&pool, at]()
+    {
+      write_task(pool, at, 3);
+    });
+    auto rhs = std::async(std::launch::async, [&pool, at]()
+    {
+      write_task(pool, at, 6);
+    });
+    lhs.get();
+    rhs.get();
+  };
+
+  auto begin = std::chrono::steady_clock::now();
+  run(sleep_pool);
+  auto slept = std::chrono::steady_clock::now() - begin;
+  EXPECT_GE(slept, std::chrono::milliseconds(120));
+  EXPECT_LT(slept, std::chrono::milliseconds(170));
+
+  run(virtual_pool);
+  EXPECT_EQ(clock->now(), 120);
+
+  // the order the tasks end in on the host does not move the tape time
+  const std::size_t at = virtual_pool.elapsed();
+  write_task(virtual_pool, at, 6);
+  write_task(virtual_pool, at, 3);
+  EXPECT_EQ(clock->now(), 240);
+}
@@ -0,0 +1,27 @@
+#ifndef BBTAPE_TESTS_TEST_UTILS_HPP
+#define BBTAPE_TESTS_TEST_UTILS_HPP
+
+#include <bbtape/config.hpp>
+#include <bbtape/tape_handler.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// fixtures shared by the test files
+namespace
+{
+  bb::config test_config = {{0, 0, 0, 0}, {1, 1}};
+
+  bb::shared_tape_handlers< int32_t >
+  make_tape_handlers(std::size_t amount)
+  {
+    bb::shared_tape_handlers< int32_t > ths;
+    for (std::size_t i = 0; i < amount; ++i)
+    {
+      ths.push_back(std::make_shared< bb::tape_handler< int32_t > >(test_config));
+    }
+    return ths;
+  }
+}
+
+#endif